@@ -0,0 +1,151 @@
+#include "CpuTracer.hpp"
+#include "helpers.hpp"
+#include <format>
+#include <print>
+#include <utility>
+
+namespace Core
+{
+namespace
+{
+// ring of the calling thread, registered on its first event
+thread_local void *tlsThreadBuffer = nullptr;
+} // namespace
+
+CpuTracer &CpuTracer::instance()
+{
+    static CpuTracer tracer;
+    return tracer;
+}
+
+CpuTracer::~CpuTracer()
+{
+    stop();
+}
+
+void CpuTracer::start(std::filesystem::path const &path, std::chrono::milliseconds flushInterval)
+{
+    stop();
+
+    {
+        std::lock_guard lock(flushMutex);
+        file.open(path, std::ios::trunc);
+        if (!file)
+        {
+            std::println("could not open {} for the cpu trace", path.string());
+            return;
+        }
+        // json array format, viewers accept it without the closing bracket if the process dies
+        file << "[";
+        firstEvent = true;
+        originNs = now();
+
+        // events left from a previous run would land before the origin
+        std::lock_guard buffersLock(buffersMutex);
+        for (auto &buffer : buffers)
+        {
+            buffer->tail.store(buffer->head.load(std::memory_order_acquire), std::memory_order_release);
+            buffer->threadNameWritten = false;
+        }
+    }
+
+    enabled.store(true, std::memory_order_relaxed);
+    flushThread = std::jthread(
+        [this, flushInterval](std::stop_token stopToken) { flushLoop(stopToken, flushInterval); });
+}
+
+void CpuTracer::stop()
+{
+    if (!enabled.exchange(false, std::memory_order_relaxed))
+        return;
+
+    flushThread.request_stop();
+    flushThread = {}; // joins
+
+    std::lock_guard lock(flushMutex);
+    drain();
+    file << "\n]\n";
+    file.close();
+    if (auto dropped = droppedEvents.exchange(0, std::memory_order_relaxed))
+        std::println("cpu trace dropped {} events, the rings were full", dropped);
+}
+
+void CpuTracer::setThreadName(std::string_view name)
+{
+    auto &buffer = getThreadBuffer();
+    std::lock_guard lock(buffersMutex);
+    buffer.threadName = name;
+    buffer.threadNameWritten = false;
+}
+
+void CpuTracer::record(char const *name, uint64_t beginNs, uint64_t endNs)
+{
+    if (!isEnabled())
+        return;
+
+    auto &buffer = getThreadBuffer();
+    auto head = buffer.head.load(std::memory_order_relaxed);
+    if (head - buffer.tail.load(std::memory_order_acquire) >= ThreadBuffer::capacity)
+    {
+        droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer.events[head % ThreadBuffer::capacity] = Event{name, beginNs, endNs};
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+CpuTracer::ThreadBuffer &CpuTracer::getThreadBuffer()
+{
+    if (tlsThreadBuffer)
+        return *static_cast<ThreadBuffer *>(tlsThreadBuffer);
+
+    std::lock_guard lock(buffersMutex);
+    auto &buffer = *buffers.emplace_back(std::make_unique<ThreadBuffer>());
+    buffer.threadId = static_cast<uint32_t>(buffers.size());
+    tlsThreadBuffer = &buffer;
+    return buffer;
+}
+
+void CpuTracer::flushLoop(std::stop_token stopToken, std::chrono::milliseconds flushInterval)
+{
+    std::unique_lock lock(flushMutex);
+    while (!stopToken.stop_requested())
+    {
+        flushCondition.wait_for(lock, stopToken, flushInterval, [] { return false; });
+        drain();
+        file.flush();
+    }
+}
+
+void CpuTracer::drain()
+{
+    auto separator = [this] { return std::exchange(firstEvent, false) ? "\n" : ",\n"; };
+
+    std::lock_guard lock(buffersMutex);
+    for (auto &buffer : buffers)
+    {
+        if (!buffer->threadNameWritten and !buffer->threadName.empty())
+        {
+            file << std::format("{}{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},"
+                                "\"args\":{{\"name\":\"{}\"}}}}",
+                                separator(), buffer->threadId, helpers::escapeJson(buffer->threadName));
+            buffer->threadNameWritten = true;
+        }
+
+        auto tail = buffer->tail.load(std::memory_order_relaxed);
+        auto head = buffer->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail)
+        {
+            auto const &event = buffer->events[tail % ThreadBuffer::capacity];
+            if (event.beginNs < originNs)
+                continue;
+            file << std::format("{}{{\"name\":\"{}\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":{},"
+                                "\"ts\":{:.3f},\"dur\":{:.3f}}}",
+                                separator(), helpers::escapeJson(event.name), buffer->threadId,
+                                static_cast<double>(event.beginNs - originNs) / 1e3,
+                                static_cast<double>(event.endNs - event.beginNs) / 1e3);
+        }
+        buffer->tail.store(head, std::memory_order_release);
+    }
+}
+} // namespace Core
\ No newline at end of file
@@ -0,0 +1,121 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace Core
+{
+// scoped cpu zones written into per thread single producer rings, a background thread drains them into a chrome
+// trace / perfetto json file. a disabled tracer costs one relaxed load per zone, an enabled one two clock reads and
+// a ring write, events are dropped (and counted) instead of blocking when a ring is full
+class CpuTracer
+{
+  public:
+    static CpuTracer &instance();
+
+    // truncates path and starts writing events to it, restarts when already running
+    void start(std::filesystem::path const &path,
+               std::chrono::milliseconds flushInterval = std::chrono::milliseconds{100});
+    // drains the remaining events and closes the file
+    void stop();
+
+    bool isEnabled() const
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    // name shown for the calling thread in the trace viewer
+    void setThreadName(std::string_view name);
+
+    // name must outlive the tracer, string literals and __func__ do
+    void record(char const *name, uint64_t beginNs, uint64_t endNs);
+
+    uint64_t getDroppedEventCount() const
+    {
+        return droppedEvents.load(std::memory_order_relaxed);
+    }
+
+    static uint64_t now()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                         std::chrono::steady_clock::now().time_since_epoch())
+                                         .count());
+    }
+
+    class Scope
+    {
+      public:
+        explicit Scope(char const *name_) : name(name_), beginNs(instance().isEnabled() ? now() : 0)
+        {
+        }
+        Scope(Scope const &) = delete;
+        Scope &operator=(Scope const &) = delete;
+        ~Scope()
+        {
+            if (beginNs != 0)
+                instance().record(name, beginNs, now());
+        }
+
+      private:
+        char const *name;
+        uint64_t beginNs;
+    };
+
+  private:
+    struct Event
+    {
+        char const *name;
+        uint64_t beginNs;
+        uint64_t endNs;
+    };
+    // written by its thread only, read by the flush thread
+    struct ThreadBuffer
+    {
+        static constexpr uint64_t capacity = 1 << 14;
+        std::unique_ptr<Event[]> events = std::make_unique<Event[]>(capacity);
+        alignas(64) std::atomic<uint64_t> head{0}; // next write, owned by the producer
+        alignas(64) std::atomic<uint64_t> tail{0}; // next read, owned by the flush thread
+        uint32_t threadId = 0;
+        std::string threadName;        // guarded by the tracer's mutex
+        bool threadNameWritten = false; // guarded by the tracer's mutex
+    };
+
+    CpuTracer() = default;
+    ~CpuTracer();
+    ThreadBuffer &getThreadBuffer();
+    void flushLoop(std::stop_token stopToken, std::chrono::milliseconds flushInterval);
+    void drain(); // flushMutex must be held
+
+    std::atomic<bool> enabled{false};
+    std::atomic<uint64_t> droppedEvents{0};
+
+    std::mutex buffersMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers; // never shrinks, threads keep pointers into it
+
+    std::mutex flushMutex;
+    std::condition_variable_any flushCondition; // only woken by stop requests
+    std::ofstream file;
+    uint64_t originNs = 0;
+    bool firstEvent = true;
+    std::jthread flushThread;
+};
+} // namespace Core
+
+#if defined(NDEEX_DISABLE_TRACING)
+#define NDEEX_TRACE_SCOPE(name)
+#else
+#define NDEEX_TRACE_CONCAT_IMPL(a, b) a##b
+#define NDEEX_TRACE_CONCAT(a, b) NDEEX_TRACE_CONCAT_IMPL(a, b)
+// traces the rest of the enclosing scope, name must be a string literal
+#define NDEEX_TRACE_SCOPE(name) ::Core::CpuTracer::Scope NDEEX_TRACE_CONCAT(traceScope_, __LINE__)(name)
+#endif
+#define NDEEX_TRACE_FUNCTION() NDEEX_TRACE_SCOPE(__func__)
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// defers destruction until the gpu timeline passed the value of the last submission using a resource,
+// so replacing resources never has to idle the queue
+class DeletionQueue
+{
+  public:
+    using Deleter = std::move_only_function<void()>;
+
+    // deleter runs once collect sees timelineValue completed
+    void push(uint64_t timelineValue, Deleter deleter)
+    {
+        entries.push_back(Entry{timelineValue, std::move(deleter)});
+    }
+
+    // object is destroyed once timelineValue is completed
+    template <typename T> void retire(uint64_t timelineValue, T object)
+    {
+        push(timelineValue, [retired = std::move(object)] {});
+    }
+
+    void collect(uint64_t completedValue)
+    {
+        // values are not monotonic, callers may add margins, so scan everything. the order does not matter and
+        // unlike stable_partition this needs no temporary buffer
+        auto completed = std::ranges::partition(entries, [&](Entry const &entry) {
+                             return entry.timelineValue > completedValue;
+                         }).begin();
+        for (auto it = completed; it != entries.end(); ++it)
+            it->deleter();
+        entries.erase(completed, entries.end());
+    }
+
+    // runs everything, the device must be idle
+    void flush()
+    {
+        for (auto &entry : entries)
+            entry.deleter();
+        entries.clear();
+    }
+
+    std::size_t size() const
+    {
+        return entries.size();
+    }
+
+  private:
+    struct Entry
+    {
+        uint64_t timelineValue;
+        Deleter deleter;
+    };
+    std::vector<Entry> entries;
+};
\ No newline at end of file
@@ -7,21 +7,61 @@
 #include <chrono>
 #include <cstdint>
 #include <cstring>
+#include <format>
+#include <iterator>
+#include <memory_resource>
 #include <optional>
 #include <print>
+#include <span>
+#include <utility>
 #include <vk_mem_alloc.h>
 
 namespace Core
 {
 
-Engine::Engine() : window(Core::WindowCreateInfo{1024, 800, "ndeex"})
+Engine::Engine(EngineCreateInfo const &createInfo)
+    : extent{createInfo.width, createInfo.height}, asyncTransfer(createInfo.asyncTransfer),
+      framesInFlight(std::max(createInfo.framesInFlight, 1u)), defragmentUnusedRatio(createInfo.defragmentUnusedRatio),
+      pipelineStatisticsEnabled(createInfo.gpuPipelineStatistics), recordingThreads(createInfo.recordingThreads),
+      jobSystem(createInfo.workerThreads), initialPresentMode(createInfo.presentMode),
+      maxQueuedPresents(createInfo.maxQueuedPresents),
+      frameArena(createInfo.frameArenaBytes, createInfo.frameArenaHugePages), vertexPulling(createInfo.vertexPulling)
 {
+    if (not createInfo.cpuTracePath.empty())
+    {
+        CpuTracer::instance().start(createInfo.cpuTracePath);
+        CpuTracer::instance().setThreadName("engine");
+        cpuTraceStarted = true;
+    }
+    if (not createInfo.metricsPath.empty())
+        metrics.startDump(createInfo.metricsPath);
+    if (not createInfo.headless)
+        window.emplace(Core::WindowCreateInfo{createInfo.width, createInfo.height, createInfo.title});
+
     initCoreHandles();
     initVMA();
+    stagingRing.emplace(allocator.getHandle(), createInfo.stagingBytesPerFrame, framesInFlight);
+    if (createInfo.defragmentBytesPerFrame > 0)
+        defragmenter.emplace(allocator.getHandle(), device, createInfo.defragmentBytesPerFrame, 64u);
+    if (createInfo.geometryArenaBytes > 0)
+        geometry = vma::GeometryArena(allocator.getHandle(), createInfo.geometryArenaBytes,
+                                      vertexPulling ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+                                                    : 0);
+    memoryBudget = MemoryBudget(allocator.getHandle(), metrics, memoryBudgetSupported);
+    // compaction is the cheapest way out, it releases emptied blocks without dropping anything
+    if (defragmenter)
+        memoryBudget.addEvictor(0,
+                                [this](uint32_t heapIndex, vk::DeviceSize) { return evictByDefragmenting(heapIndex); });
     initSwapchain();
-    initImGui();
+    if (window)
+        initImGui();
     initVertexBuffer();
     initShaderObjects();
+    setScene({Vertex{.position = {-0.5, -0.5}, .color = {1.0, 0.0, 0.0}},
+              Vertex{.position = {0.5, -0.5}, .color = {0.0, 1.0, 0.0}},
+              Vertex{.position = {0.0, 0.5}, .color = {0.0, 0.0, 1.0}}},
+             {SceneDraw{0, 3, false}, SceneDraw{0, 3, true}}, vk::PrimitiveTopology::eTriangleFan);
     clearColor = vk::ClearValue{std::array<float, 4>{0.5f, 0.2f, 0.2f, 1.0f}};
 }
 
@@ -32,7 +72,8 @@ void Engine::initCoreHandles()
     VULKAN_HPP_DEFAULT_DISPATCHER.init(vkGetInstanceProcAddr);
 
     std::vector<const char *> requiredExtensions;
-    requiredExtensions.append_range(window.getRequiredInstanceExtensions());
+    if (window)
+        requiredExtensions.append_range(window->getRequiredInstanceExtensions());
     vkInstance = helpers::vulkan::create_instance("ndeex", 1, "ndeexEngine", 1, requiredExtensions, {});
 #if defined(DEBUG)
     debug_utils_messenger = vkInstance.createDebugUtilsMessengerEXT(
@@ -44,22 +85,79 @@ void Engine::initCoreHandles()
 #endif
 
     // surface creation
-    surface = window.createSurface(vkInstance);
+    std::optional<vk::SurfaceKHR> presentSurface;
+    if (window)
+    {
+        surface = window->createSurface(vkInstance);
+        presentSurface = surface;
+    }
 
+    // lavapipe reports itself as eCpu, keep it as the last resort so headless runs work on gpu-less machines
+    constexpr std::array preferredDeviceTypes{vk::PhysicalDeviceType::eDiscreteGpu,
+                                              vk::PhysicalDeviceType::eIntegratedGpu,
+                                              vk::PhysicalDeviceType::eVirtualGpu, vk::PhysicalDeviceType::eCpu};
     auto [chosenDevice, chosenQueueFamiliyIndex] = helpers::vulkan::getFirstSupportedDeviceQueueSelection(
-        vkInstance, vk::PhysicalDeviceType::eDiscreteGpu, vk::QueueFlagBits::eGraphics, surface);
+        vkInstance, preferredDeviceTypes, vk::QueueFlagBits::eGraphics, presentSurface);
     physicalDevice = chosenDevice;
     graphicsQueueFamilyIndex = chosenQueueFamiliyIndex;
     std::println("chosen physical device:{}", physicalDevice.getProperties().deviceName.data());
     std::println("found queue familyIndex:{}", graphicsQueueFamilyIndex);
 
-    device = helpers::vulkan::create_device(
-        {physicalDevice, graphicsQueueFamilyIndex},
-        {VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME, VK_EXT_SHADER_OBJECT_EXTENSION_NAME},
-        {});
+    std::vector<const char *> deviceExtensions{VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
+                                               VK_EXT_SHADER_OBJECT_EXTENSION_NAME};
+    if (window)
+        deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+    // without it vma estimates usage from its own allocations and the budget from the heap sizes
+    memoryBudgetSupported =
+        helpers::vulkan::isDeviceExtensionSupported(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (memoryBudgetSupported)
+        deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    std::println("memory budget:{}", memoryBudgetSupported);
+
+    // present wait is optional, it only feeds the latency measurement and the queued present limit
+    vk::PhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+    vk::PhysicalDevicePresentIdFeaturesKHR presentIdFeatures{.pNext = &presentWaitFeatures};
+    if (window and helpers::vulkan::isDeviceExtensionSupported(physicalDevice, VK_KHR_PRESENT_ID_EXTENSION_NAME) and
+        helpers::vulkan::isDeviceExtensionSupported(physicalDevice, VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+    {
+        vk::PhysicalDeviceFeatures2 features{.pNext = &presentIdFeatures};
+        physicalDevice.getFeatures2(&features);
+        presentWaitSupported = presentIdFeatures.presentId and presentWaitFeatures.presentWait;
+    }
+    if (presentWaitSupported)
+    {
+        deviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        deviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+    }
+    std::println("present wait:{}", presentWaitSupported);
+
+    // statistics queries of the gpu profiler span the frame, secondaries could only take part with inheritedQueries
+    auto supportedFeatures = physicalDevice.getFeatures();
+    pipelineStatisticsEnabled =
+        pipelineStatisticsEnabled and recordingThreads == 0 and supportedFeatures.pipelineStatisticsQuery;
+    // mesh scenes draw a run of meshes with one indirect call, otherwise one call per mesh
+    if (supportedFeatures.multiDrawIndirect)
+        maxDrawIndirectCount = physicalDevice.getProperties().limits.maxDrawIndirectCount;
+    vk::PhysicalDeviceFeatures2 optionalCoreFeatures{
+        .pNext = presentWaitSupported ? &presentIdFeatures : nullptr,
+        .features = {.multiDrawIndirect = supportedFeatures.multiDrawIndirect,
+                     .pipelineStatisticsQuery = pipelineStatisticsEnabled},
+    };
+    if (asyncTransfer)
+        transferQueueFamilyIndex = helpers::vulkan::findDedicatedTransferQueueFamily(physicalDevice);
+    std::println("transfer queue familyIndex:{}",
+                 transferQueueFamilyIndex ? std::to_string(transferQueueFamilyIndex.value()) : "none");
+    std::span<uint32_t const> extraQueueFamilies;
+    if (transferQueueFamilyIndex)
+        extraQueueFamilies = {&transferQueueFamilyIndex.value(), 1};
+    device = helpers::vulkan::create_device({physicalDevice, graphicsQueueFamilyIndex}, deviceExtensions, {},
+                                            &optionalCoreFeatures, extraQueueFamilies);
     VULKAN_HPP_DEFAULT_DISPATCHER.init(device);
 
     graphicsQueue = device.getQueue(graphicsQueueFamilyIndex, 0);
+    if (transferQueueFamilyIndex)
+        transferQueue.emplace(device, transferQueueFamilyIndex.value(), graphicsQueueFamilyIndex);
 }
 
 void Engine::initVMA()
@@ -69,7 +167,10 @@ void Engine::initVMA()
     vulkanFunctions.vkGetDeviceProcAddr = vkGetDeviceProcAddr;
 
     VmaAllocatorCreateInfo allocatorCreateInfo = {};
-    allocatorCreateInfo.flags = VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    allocatorCreateInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+    // only valid with the extension enabled on the device
+    if (memoryBudgetSupported)
+        allocatorCreateInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
     allocatorCreateInfo.vulkanApiVersion = VK_API_VERSION_1_4;
     allocatorCreateInfo.physicalDevice = physicalDevice;
     allocatorCreateInfo.device = device;
@@ -83,19 +184,43 @@ void Engine::initVMA()
 void Engine::initSwapchain()
 {
     vk::Format requiredFormat = vk::Format::eR8G8B8A8Srgb;
-    swapchain = Swapchain{physicalDevice, device, surface, requiredFormat};
-    renderSyncs = RenderSyncContainer(device);
+    if (window)
+        swapchain =
+            Swapchain{physicalDevice, device, surface, requiredFormat, initialPresentMode, presentWaitSupported};
+    else
+        offscreen = Offscreen{device, allocator.getHandle(), requiredFormat};
+    initFrames();
     swapChainRecreate();
+}
 
+// frames in flight are independent of the swapchain image count and survive swapchain recreation
+void Engine::initFrames()
+{
     vk::CommandPoolCreateInfo poolInfo{
         .flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
         .queueFamilyIndex = graphicsQueueFamilyIndex,
     };
+    timeline = GpuTimeline{device};
     commandPool = device.createCommandPoolUnique(poolInfo);
-    commandBuffers = device.allocateCommandBuffersUnique(
+    auto commandBuffers = device.allocateCommandBuffersUnique(
         vk::CommandBufferAllocateInfo{.commandPool = commandPool.get(),
                                       .level = vk::CommandBufferLevel::ePrimary,
-                                      .commandBufferCount = static_cast<uint32_t>(swapchain.size())});
+                                      .commandBufferCount = framesInFlight});
+
+    frames.clear();
+    for (auto &commandBuffer : commandBuffers)
+    {
+        frames.push_back(FrameResources{
+            .commandBuffer = std::move(commandBuffer),
+            .sem_ImageAcquired = device.createSemaphoreUnique({}),
+        });
+    }
+
+    if (recordingThreads > 0)
+        recorder = ParallelRecorder(device, graphicsQueueFamilyIndex, recordingThreads, framesInFlight);
+
+    gpuProfiler = GpuProfiler(physicalDevice, device, graphicsQueueFamilyIndex, framesInFlight,
+                              pipelineStatisticsEnabled);
 }
 
 void Engine::initImGui()
@@ -106,53 +231,156 @@ void Engine::initImGui()
         .device = device,
         .graphicsQueueFamilyIndex = graphicsQueueFamilyIndex,
         .graphicsQueue = graphicsQueue,
-        .imageCount = 2,
+        .imageCount = std::max(framesInFlight, 2u),
         .sampleCount = vk::SampleCountFlagBits::e1,
         .descriptorPoolSize = 2,
-        .window = window.getHandle(),
+        .window = window->getHandle(),
         .format = swapchain.getFormat(),
     });
 }
 
 void Engine::initVertexBuffer()
 {
-    // vertex buffer
-    vertexBuffer.vertices() = {Vertex{
-                                   .position = {-0.5, -0.5},
-                                   .color = {1.0, 0.0, 0.0},
-                               },
-                               Vertex{
-                                   .position = {0.5, -0.5},
-                                   .color = {0.0, 1.0, 0.0},
-                               },
-                               Vertex{
-                                   .position = {0.0, 0.5},
-                                   .color = {0.0, 0.0, 1.0},
-                               }};
+    // vertex and index buffer, filled by setScene
+    vertexBuffer = vma::VertexBuffer<Vertex>(framesInFlight, VertexMode::eDynamic, getVertexFetch());
+    indexBuffer = vma::IndexBuffer<uint32_t>(framesInFlight);
+}
+
+// frames in flight may still read the old buffer
+void Engine::resetVertexBuffer(VertexMode mode)
+{
+    deletionQueue.retire(timeline.getPendingValue(), std::exchange(vertexBuffer, {}));
+    deletionQueue.retire(timeline.getPendingValue(), std::exchange(indexBuffer, {}));
+    vertexBuffer = vma::VertexBuffer<Vertex>(framesInFlight, mode, getVertexFetch());
+    // streamed scenes are not indexed
+    indexBuffer = vma::IndexBuffer<uint32_t>(framesInFlight, mode == VertexMode::eMapped ? VertexMode::eDynamic : mode);
+    vertexWriter = {};
+    streamedVertexCount = 0;
+}
+
+void Engine::setScene(std::vector<Vertex> vertices, std::vector<SceneDraw> const &draws,
+                      vk::PrimitiveTopology topology, VertexMode mode)
+{
+    setIndexedScene(std::move(vertices), {}, draws, topology, mode);
+}
+
+void Engine::setIndexedScene(std::vector<Vertex> vertices, std::vector<uint32_t> indices,
+                             std::vector<SceneDraw> const &draws, vk::PrimitiveTopology topology, VertexMode mode)
+{
+    if (mode != vertexBuffer.getMode() or mode == VertexMode::eStatic)
+        resetVertexBuffer(mode);
+    vertexBuffer.vertices() = std::move(vertices);
+    markVerticesDirty(0);
+    sceneIndexed = !indices.empty();
+    indexBuffer.indices() = std::move(indices);
+    indexBuffer.markDirty(0);
+    setDraws(draws, topology);
+}
+
+void Engine::setStreamedScene(size_t vertexCount, std::vector<SceneDraw> const &draws, VertexWriter writer,
+                              vk::PrimitiveTopology topology)
+{
+    resetVertexBuffer(VertexMode::eMapped);
+    vertexWriter = std::move(writer);
+    streamedVertexCount = vertexCount;
+    sceneIndexed = false;
+    setDraws(draws, topology);
+}
+
+void Engine::setDraws(std::vector<SceneDraw> const &draws, vk::PrimitiveTopology topology)
+{
+    // set here, recording threads only read the shader objects
+    shaderObject.setPrimitiveTopology(topology);
+    shaderObject2.setPrimitiveTopology(topology);
+
+    drawCalls.clear();
+    for (auto const &draw : draws)
+    {
+        drawCalls.push_back(
+            DrawCall{draw.flipped ? &shaderObject2 : &shaderObject, draw.firstVertex, draw.vertexCount});
+    }
+    meshScene = false;
+    indirectCommands.clear();
+}
+
+uint32_t Engine::addMesh(std::span<Vertex const> vertices, std::span<uint32_t const> indices)
+{
+    Mesh mesh{.vertices = geometry.allocate(vertices.size(), sizeof(Vertex)),
+              .indices = geometry.allocate(indices.size(), sizeof(uint32_t))};
+    geometry.upload(mesh.vertices, std::as_bytes(vertices));
+    geometry.upload(mesh.indices, std::as_bytes(indices));
+    meshes.emplace(nextMeshId, mesh);
+    return nextMeshId++;
+}
+
+void Engine::removeMesh(uint32_t meshId)
+{
+    auto mesh = meshes.at(meshId);
+    meshes.erase(meshId);
+    deletionQueue.push(timeline.getPendingValue(), [this, mesh] {
+        geometry.free(mesh.vertices);
+        geometry.free(mesh.indices);
+    });
+}
+
+void Engine::setMeshScene(std::vector<MeshDraw> const &draws, vk::PrimitiveTopology topology)
+{
+    // the vertices of the previous scene are not needed anymore
+    resetVertexBuffer(VertexMode::eDynamic);
+    sceneIndexed = false;
+    setDraws({}, topology);
+
+    for (auto const &draw : draws)
+    {
+        auto const &mesh = meshes.at(draw.mesh);
+        auto firstIndex = static_cast<uint32_t>(mesh.indices.offset / sizeof(uint32_t));
+        auto indexCount = static_cast<uint32_t>(mesh.indices.size / sizeof(uint32_t));
+        drawCalls.push_back(DrawCall{draw.flipped ? &shaderObject2 : &shaderObject, firstIndex, indexCount});
+        indirectCommands.push_back(
+            vk::DrawIndexedIndirectCommand{.indexCount = indexCount,
+                                           .instanceCount = 1,
+                                           .firstIndex = firstIndex,
+                                           .vertexOffset = static_cast<int32_t>(mesh.vertices.offset / sizeof(Vertex)),
+                                           .firstInstance = 0});
+    }
+    meshScene = true;
 }
 
 void Engine::initShaderObjects()
 {
     // shader object setup
-    shaderObject = ShaderObject(device, "triangle.vert.spv", "triangle.frag.spv");
-    shaderObject2 = ShaderObject(device, "triangle.vert.spv", "triangle.frag.spv");
+    if (vertexPulling)
+    {
+        vk::PushConstantRange vertexAddress{
+            .stageFlags = vk::ShaderStageFlagBits::eVertex, .offset = 0, .size = sizeof(vk::DeviceAddress)};
+        shaderObject = ShaderObject(device, "triangle_pull.vert.spv", "triangle.frag.spv", {&vertexAddress, 1});
+        shaderObject2 = ShaderObject(device, "triangle_pull.vert.spv", "triangle.frag.spv", {&vertexAddress, 1});
+    }
+    else
+    {
+        shaderObject = ShaderObject(device, "triangle.vert.spv", "triangle.frag.spv");
+        shaderObject2 = ShaderObject(device, "triangle.vert.spv", "triangle.frag.spv");
+    }
     shaderObject.setViewport({.x = 0,
                               .y = 0,
-                              .width = static_cast<float>(window.getInfo().width),
-                              .height = static_cast<float>(window.getInfo().height)});
+                              .width = static_cast<float>(extent.width),
+                              .height = static_cast<float>(extent.height)});
     shaderObject.setScissor(vk::Rect2D{.offset{.x = 0, .y = 0},
-                                       .extent = {.width = window.getInfo().width, .height = window.getInfo().height}});
+                                       .extent = {.width = extent.width, .height = extent.height}});
 
     shaderObject2.setViewport({.x = 0,
-                               .y = static_cast<float>(window.getInfo().height),
-                               .width = static_cast<float>(window.getInfo().width),
-                               .height = -static_cast<float>(window.getInfo().height)});
+                               .y = static_cast<float>(extent.height),
+                               .width = static_cast<float>(extent.width),
+                               .height = -static_cast<float>(extent.height)});
     shaderObject2.setScissor(vk::Rect2D{
-        .offset{.x = 0, .y = 0}, .extent = {.width = window.getInfo().width, .height = window.getInfo().height}});
+        .offset{.x = 0, .y = 0}, .extent = {.width = extent.width, .height = extent.height}});
 
     shaderObject.setColorBlendEnable(0, false);
     shaderObject2.setColorBlendEnable(0, false);
 
+    // pulled vertices leave the vertex input state empty
+    if (vertexPulling)
+        return;
     // shader vertex inputs
     shaderObject.vertexBindings().push_back(vk::VertexInputBindingDescription2EXT{
         .binding = 0,
@@ -180,22 +408,38 @@ void Engine::initShaderObjects()
 Engine::~Engine()
 {
     device.waitIdle();
+    deletionQueue.flush();
+    if (cpuTraceStarted)
+        CpuTracer::instance().stop();
 }
 
 Swapchain::RenderTarget *Engine::acquireRenderTarget(std::chrono::milliseconds timeout)
 {
-    auto &renderSync = getFrameRenderSync();
-    // wait for previous rendering on the same image be finished
-    VULKAN_CHECKTHROW(device.waitForFences(1, &renderSync.fence_RenderFinished.get(), true, 1000));
-    VULKAN_CHECKTHROW(device.resetFences(1, &renderSync.fence_RenderFinished.get()));
+    NDEEX_TRACE_FUNCTION();
+    auto &frame = getFrame();
+    // wait for the previous use of this frame's resources to be finished, i.e. timeline >= frame - framesInFlight
+    auto waitBegin = std::chrono::steady_clock::now();
+    timeline.wait(frame.submitValue);
+    frameSlotWaitMetric.record(
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitBegin).count());
+    deletionQueue.collect(timeline.getCompletedValue());
+    stagingRing->beginFrame(getFrameIndex());
+    memoryBudget.update(currentFrame);
+    stagingUsedMetric.set(0.0);
+
+    if (!window)
+        return &offscreen.getRenderTarget(getFrameIndex());
 
     std::optional<uint32_t> renderTargetIndexResult{};
 
     auto end = std::chrono::system_clock::now() + timeout;
     while (std::chrono::system_clock::now() <= end)
     {
+        auto acquireBegin = std::chrono::steady_clock::now();
         renderTargetIndexResult =
-            swapchain.acquireNextRenderTarget(std::chrono::seconds{5}, renderSync.sem_ImageAcquired.get(), {});
+            swapchain.acquireNextRenderTarget(std::chrono::seconds{5}, frame.sem_ImageAcquired.get(), {});
+        acquireWaitMetric.record(
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - acquireBegin).count());
         if (!renderTargetIndexResult)
         {
             swapChainRecreate();
@@ -216,26 +460,7 @@ void Engine::beginRecording(vk::CommandBuffer cmd)
     cmd.begin(vk::CommandBufferBeginInfo{.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
 }
 
-void Engine::transitionToRender(vk::CommandBuffer cmd, Swapchain::RenderTarget &renderTarget)
-{
-    vk::ImageMemoryBarrier imageBarrier{.srcAccessMask = vk::AccessFlagBits::eNone,
-                                        .dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
-                                        .oldLayout = vk::ImageLayout::eUndefined,
-                                        .newLayout = vk::ImageLayout::eColorAttachmentOptimal,
-                                        .srcQueueFamilyIndex = graphicsQueueFamilyIndex,
-                                        .dstQueueFamilyIndex = graphicsQueueFamilyIndex,
-                                        .image = renderTarget.imageHandle,
-                                        .subresourceRange =
-                                            vk::ImageSubresourceRange{.aspectMask = vk::ImageAspectFlagBits::eColor,
-                                                                      .baseMipLevel = 0,
-                                                                      .levelCount = 1,
-                                                                      .baseArrayLayer = 0,
-                                                                      .layerCount = 1}};
-    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eColorAttachmentOutput,
-                        vk::DependencyFlagBits{}, nullptr, nullptr, {imageBarrier});
-}
-
-void Engine::beginRendering(vk::CommandBuffer cmd, Swapchain::RenderTarget &renderTarget)
+void Engine::beginRendering(vk::CommandBuffer cmd, Swapchain::RenderTarget &renderTarget, vk::RenderingFlags flags)
 {
     vk::RenderingAttachmentInfo colorAttachment{.imageView = renderTarget.imageView.get(),
                                                 .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
@@ -244,7 +469,8 @@ void Engine::beginRendering(vk::CommandBuffer cmd, Swapchain::RenderTarget &rend
                                                 .clearValue = clearColor};
 
     vk::RenderingInfo renderingInfo{
-        .renderArea = {{0, 0}, {window.getInfo().width, window.getInfo().height}},
+        .flags = flags,
+        .renderArea = {{0, 0}, extent},
         .layerCount = 1,
         .colorAttachmentCount = 1,
         .pColorAttachments = &colorAttachment,
@@ -252,157 +478,483 @@ void Engine::beginRendering(vk::CommandBuffer cmd, Swapchain::RenderTarget &rend
 
     cmd.beginRendering(renderingInfo);
 }
+
+// called concurrently from the recording threads, must only read engine state
+void Engine::recordDraws(vk::CommandBuffer cmd, size_t firstDraw, size_t drawCount, uint32_t frameIndex)
+{
+    if (meshScene)
+    {
+        recordMeshDraws(cmd, firstDraw, drawCount);
+        return;
+    }
+    auto draws = std::span(drawCalls).subspan(firstDraw, drawCount);
+    // the shader objects share the push constant layout, the address stays pushed across their binds
+    if (vertexPulling and !draws.empty())
+    {
+        auto address = vertexBuffer.getDeviceAddress(frameIndex);
+        cmd.pushConstants(draws.front().shaderObject->getPipelineLayout(), vk::ShaderStageFlagBits::eVertex, 0,
+                          sizeof(address), &address);
+    }
+    if (!vertexPulling)
+        cmd.bindVertexBuffers(0, vertexBuffer.getBufferHandle(frameIndex), vk::DeviceSize(0));
+    if (sceneIndexed)
+        cmd.bindIndexBuffer(indexBuffer.getBufferHandle(frameIndex), 0, indexBuffer.indexType);
+    // draws of the same shader object emit no state, cmd is one command buffer from here to the last draw
+    DynamicStateTracker tracker;
+    drawCommandCount.fetch_add(static_cast<uint32_t>(draws.size()), std::memory_order_relaxed);
+    for (auto &drawCall : draws)
+    {
+        drawCall.shaderObject->setState(cmd, tracker);
+        drawCall.shaderObject->bind(cmd, tracker);
+        if (sceneIndexed)
+            cmd.drawIndexed(drawCall.vertexCount, 1, drawCall.firstVertex, 0, 0);
+        else
+            cmd.draw(drawCall.vertexCount, 1, drawCall.firstVertex, 0);
+    }
+}
+void Engine::recordMeshDraws(vk::CommandBuffer cmd, size_t firstDraw, size_t drawCount)
+{
+    if (drawCount == 0)
+        return;
+    if (vertexPulling)
+    {
+        auto address = geometry.getDeviceAddress();
+        cmd.pushConstants(drawCalls[firstDraw].shaderObject->getPipelineLayout(), vk::ShaderStageFlagBits::eVertex, 0,
+                          sizeof(address), &address);
+    }
+    else
+    {
+        cmd.bindVertexBuffers(0, geometry.getBufferHandle(), vk::DeviceSize(0));
+    }
+    cmd.bindIndexBuffer(geometry.getBufferHandle(), 0, vk::IndexType::eUint32);
+
+    constexpr uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+    DynamicStateTracker tracker;
+    auto end = firstDraw + drawCount;
+    for (auto begin = firstDraw; begin < end;)
+    {
+        // every mesh of a run of the same shader object in one call
+        auto *runShaderObject = drawCalls[begin].shaderObject;
+        auto runEnd = begin + 1;
+        while (runEnd < end and runEnd - begin < maxDrawIndirectCount and
+               drawCalls[runEnd].shaderObject == runShaderObject)
+            ++runEnd;
+        runShaderObject->setState(cmd, tracker);
+        runShaderObject->bind(cmd, tracker);
+        cmd.drawIndexedIndirect(frameIndirectCommands.buffer, frameIndirectCommands.offset + begin * stride,
+                                static_cast<uint32_t>(runEnd - begin), stride);
+        drawCommandCount.fetch_add(1, std::memory_order_relaxed);
+        begin = runEnd;
+    }
+}
 void Engine::endRendering(vk::CommandBuffer cmd)
 {
     cmd.endRendering();
 }
-void Engine::transitionToPresent(vk::CommandBuffer cmd, Swapchain::RenderTarget &renderTarget)
+// passes of the frame, the graph derives the layout transitions and the upload -> vertex input dependency
+void Engine::buildRenderGraph(Swapchain::RenderTarget &renderTarget, uint32_t frameIndex, bool secondariesRecorded)
 {
-    vk::ImageMemoryBarrier presentBarrier{.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
-                                          .dstAccessMask = {},
-                                          .oldLayout = vk::ImageLayout::eColorAttachmentOptimal,
-                                          .newLayout = vk::ImageLayout::ePresentSrcKHR,
-                                          .image = renderTarget.imageHandle,
-                                          .subresourceRange =
-                                              vk::ImageSubresourceRange{.aspectMask = vk::ImageAspectFlagBits::eColor,
-                                                                        .baseMipLevel = 0,
-                                                                        .levelCount = 1,
-                                                                        .baseArrayLayer = 0,
-                                                                        .layerCount = 1}};
+    renderGraph.reset(&frameArena);
+
+    // the acquire semaphore is waited at color attachment output, the transition has to chain after it
+    auto target = renderGraph.importImage(
+        "render target", renderTarget.imageHandle,
+        vk::ImageSubresourceRange{.aspectMask = vk::ImageAspectFlagBits::eColor,
+                                  .baseMipLevel = 0,
+                                  .levelCount = 1,
+                                  .baseArrayLayer = 0,
+                                  .layerCount = 1},
+        RenderGraph::Access{vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eNone,
+                            vk::ImageLayout::eUndefined});
+    // nothing presents offscreen images, leave them ready to be read back
+    renderGraph.setFinalAccess(target, window ? RenderGraph::Present : RenderGraph::TransferRead);
+    // previous reads of this frame's copy finished before acquireRenderTarget returned
+    auto vertices = renderGraph.importBuffer("vertices");
+    auto indices = renderGraph.importBuffer("indices");
+    auto meshBuffer = renderGraph.importBuffer("meshes");
+
+    bool verticesPending = vertexBuffer.isUploadPending(frameIndex);
+    bool indicesPending = indexBuffer.isUploadPending(frameIndex);
+    auto recordUploads = [this, frameIndex](vk::CommandBuffer cmd) {
+        vertexBuffer.recordUpload(cmd, frameIndex);
+        indexBuffer.recordUpload(cmd, frameIndex);
+    };
+    if ((verticesPending or indicesPending) and transferQueue and vertexBuffer.getMode() == VertexMode::eStatic)
+    {
+        // submitted right away so the copy overlaps the recording, the draws wait for it on the gpu only
+        std::pmr::vector<vk::Buffer> buffers(&frameArena);
+        if (verticesPending)
+            buffers.push_back(vertexBuffer.getBufferHandle(frameIndex));
+        if (indicesPending)
+            buffers.push_back(indexBuffer.getBufferHandle(frameIndex));
+        pendingTransferWait = transferQueue->submit(recordUploads, buffers, &frameArena);
+        // moved, a copy of the vector would allocate from the default resource
+        renderGraph.addPass("acquire upload")
+            .sideEffects()
+            .execute([this, buffers = std::move(buffers)](vk::CommandBuffer cmd) {
+                transferQueue->recordAcquire(cmd, buffers,
+                                             vk::PipelineStageFlagBits2::eVertexAttributeInput |
+                                                 vk::PipelineStageFlagBits2::eVertexShader |
+                                                 vk::PipelineStageFlagBits2::eIndexInput,
+                                             vk::AccessFlagBits2::eVertexAttributeRead |
+                                                 vk::AccessFlagBits2::eShaderStorageRead |
+                                                 vk::AccessFlagBits2::eIndexRead,
+                                             &frameArena);
+            });
+    }
+    else if (verticesPending or indicesPending)
+    {
+        renderGraph.addPass("upload")
+            .write(vertices, RenderGraph::TransferWrite)
+            .write(indices, RenderGraph::TransferWrite)
+            .execute(recordUploads);
+    }
+
+    if (geometry.isUploadPending())
+    {
+        renderGraph.addPass("mesh upload")
+            .write(meshBuffer, RenderGraph::TransferWrite)
+            .execute([this](vk::CommandBuffer cmd) { geometry.recordUpload(cmd); });
+    }
+
+    auto vertexRead = vertexPulling ? RenderGraph::VertexShaderStorageRead : RenderGraph::VertexAttributeRead;
+    renderGraph.addPass("geometry")
+        .read(vertices, vertexRead)
+        .read(indices, RenderGraph::IndexRead)
+        .read(meshBuffer, RenderGraph::Access{vertexRead.stages | vk::PipelineStageFlagBits2::eIndexInput,
+                                              vertexRead.access | vk::AccessFlagBits2::eIndexRead})
+        .write(target, RenderGraph::ColorAttachmentWrite)
+        .execute([this, &renderTarget, frameIndex, secondariesRecorded](vk::CommandBuffer cmd) {
+            if (secondariesRecorded)
+            {
+                beginRendering(cmd, renderTarget, vk::RenderingFlagBits::eContentsSecondaryCommandBuffers);
+                recorder.execute(cmd);
+            }
+            else
+            {
+                beginRendering(cmd, renderTarget);
+                recordDraws(cmd, 0, drawCalls.size(), frameIndex);
+            }
+            endRendering(cmd);
+        });
+
+    if (window)
+        renderGraph.addPass("imgui")
+            .readWrite(target, RenderGraph::ColorAttachmentReadWrite)
+            .execute([this, &renderTarget](vk::CommandBuffer cmd) {
+                vk::RenderingAttachmentInfo colorAttachment{.imageView = renderTarget.imageView.get(),
+                                                            .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+                                                            .loadOp = vk::AttachmentLoadOp::eLoad,
+                                                            .storeOp = vk::AttachmentStoreOp::eStore,
+                                                            .clearValue = clearColor};
+
+                vk::RenderingInfo renderingInfo{
+                    .renderArea = {{0, 0}, extent},
+                    .layerCount = 1,
+                    .colorAttachmentCount = 1,
+                    .pColorAttachments = &colorAttachment,
+                };
 
-    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eBottomOfPipe,
-                        vk::DependencyFlagBits{}, nullptr, nullptr, {presentBarrier});
+                cmd.beginRendering(renderingInfo);
+                imgui.render(cmd);
+                cmd.endRendering();
+            });
+
+    renderGraph.compile();
 }
 void Engine::stopRecording(vk::CommandBuffer cmd)
 {
     cmd.end();
 }
-void Engine::submitToQueue(vk::CommandBuffer cmd)
+void Engine::submitToQueue(vk::CommandBuffer cmd, Swapchain::RenderTarget &renderTarget)
 {
-    auto &renderSync = getFrameRenderSync();
+    NDEEX_TRACE_FUNCTION();
+    auto &frame = getFrame();
+
+    frame.submitValue = timeline.nextValue();
+
+    // acquired image before drawing to it, static uploads of the transfer queue before reading the vertices
+    std::array<vk::Semaphore, 2> waitSemaphores;
+    std::array<vk::PipelineStageFlags, 2> waitStages;
+    std::array<uint64_t, 2> waitValues{}; // value of the binary semaphore is ignored
+    uint32_t waitCount = 0;
+    if (window)
+    {
+        waitSemaphores[waitCount] = frame.sem_ImageAcquired.get();
+        waitStages[waitCount++] = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+    }
+    if (pendingTransferWait)
+    {
+        waitSemaphores[waitCount] = transferQueue->getTimeline().getHandle();
+        waitStages[waitCount] = vk::PipelineStageFlagBits::eVertexInput;
+        waitValues[waitCount++] = std::exchange(pendingTransferWait, std::nullopt).value();
+    }
+
+    // binary semaphore for present goes first, offscreen targets are not acquired nor presented
+    std::array signalSemaphores{renderFinishedSemaphores.at(renderTarget.imageIndex).get(), timeline.getHandle()};
+    std::array<uint64_t, 2> signalValues{0, frame.submitValue}; // value of the binary semaphore is ignored
+    uint32_t binarySemaphoreCount = window ? 1 : 0;
 
-    vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+    vk::TimelineSemaphoreSubmitInfo timelineSubmitInfo{
+        .waitSemaphoreValueCount = waitCount,
+        .pWaitSemaphoreValues = waitValues.data(),
+        .signalSemaphoreValueCount = 1 + binarySemaphoreCount,
+        .pSignalSemaphoreValues = signalValues.data() + 1 - binarySemaphoreCount,
+    };
     vk::SubmitInfo submitInfo{
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores = &renderSync.sem_ImageAcquired.get(),
-        .pWaitDstStageMask = &waitStage,
+        .pNext = &timelineSubmitInfo,
+        .waitSemaphoreCount = waitCount,
+        .pWaitSemaphores = waitSemaphores.data(),
+        .pWaitDstStageMask = waitStages.data(),
         .commandBufferCount = 1,
         .pCommandBuffers = &cmd,
-        .signalSemaphoreCount = 1,
-        .pSignalSemaphores = &renderSync.sem_RenderFinished.get(),
+        .signalSemaphoreCount = 1 + binarySemaphoreCount,
+        .pSignalSemaphores = signalSemaphores.data() + 1 - binarySemaphoreCount,
     };
 
-    graphicsQueue.submit(submitInfo, renderSync.fence_RenderFinished.get());
+    graphicsQueue.submit(submitInfo);
 }
 
 void Engine::present(Swapchain::RenderTarget &renderTarget)
 {
-    auto &renderSync = getFrameRenderSync();
-    swapchain.presentImage(graphicsQueue, renderTarget.imageIndex, renderSync.sem_RenderFinished.get());
+    NDEEX_TRACE_FUNCTION();
+    if (!window)
+        return;
+
+    auto presentId = swapchain.presentImage(graphicsQueue, renderTarget.imageIndex,
+                                            renderFinishedSemaphores.at(renderTarget.imageIndex).get());
+    if (presentId)
+        pendingPresents.push_back(PendingPresent{presentId, inputSampleTime});
+    if (swapchain.isOutOfDate())
+        requestedExtent = requestedExtent.value_or(extent);
 }
 
-void Engine::gameloop()
+// resizes and present mode changes since the last frame cost at most one recreate, a drag resize delivers many
+void Engine::applySwapchainRequests()
+{
+    if (!requestedExtent and !requestedPresentMode)
+        return;
+    if (requestedPresentMode)
+        swapchain.setPreferredPresentMode(requestedPresentMode.value());
+    if (requestedExtent)
+        onWindowResize(requestedExtent->width, requestedExtent->height);
+    requestedPresentMode.reset();
+    requestedExtent.reset();
+    swapChainRecreate();
+}
+
+// polls which presents became visible, the time is taken when that is observed so it is an upper bound unless
+// this frame had to block for it
+void Engine::waitForQueuedPresents()
 {
-    while (not window.isCloseRequested())
+    NDEEX_TRACE_FUNCTION();
+    while (!pendingPresents.empty())
     {
-        processEvents();
+        bool mustWait = maxQueuedPresents > 0 and pendingPresents.size() >= maxQueuedPresents;
+        auto timeout = mustWait ? std::chrono::nanoseconds(std::chrono::seconds{1}) : std::chrono::nanoseconds(0);
+        if (!swapchain.waitForPresent(pendingPresents.front().presentId, timeout))
+            break;
+        lastPresentLatencyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                                         pendingPresents.front().inputSampleTime)
+                                   .count();
+        pendingPresents.pop_front();
+    }
+}
 
-        auto &renderSync = getFrameRenderSync();
-        // test change vertex data
-        auto updateVertexPosition = [](Vertex &v, uint32_t frameCount, float radius = 0.5f) {
-            float angle = frameCount * 0.05f; // Radians per frame
-            v.position[0] = radius * std::cos(angle);
-            v.position[1] = radius * std::sin(angle);
-            v.position[2] = 0.0f; // Keep on XY plane
-        };
+void Engine::gameloop()
+{
+    while (window and not window->isCloseRequested())
+    {
+        renderFrame();
+    }
+}
 
-        bool updateVertexBuffer = true;
+void Engine::renderFrame()
+{
+    NDEEX_TRACE_FUNCTION();
+    // start to start, so the frame time includes waiting for the gpu and the display
+    auto frameStart = std::chrono::steady_clock::now();
+    if (lastFrameStart)
+        frameTimeMetric.record(std::chrono::duration<double, std::milli>(frameStart - lastFrameStart.value()).count());
+    lastFrameStart = frameStart;
+    if (window)
+    {
+        waitForQueuedPresents();
+        inputSampleTime = std::chrono::steady_clock::now();
+        processEvents();
+    }
+    applySwapchainRequests();
+    // the last frame's graph is the only user of the arena left, drop it before taking the memory back
+    renderGraph.reset();
+    frameArenaBytesMetric.set(static_cast<double>(frameArena.getUsedBytes()));
+    frameArena.reset();
+
+    // test change vertex data
+    auto updateVertexPosition = [](Vertex &v, uint32_t frameCount, float radius = 0.5f) {
+        float angle = frameCount * 0.05f; // Radians per frame
+        v.position[0] = radius * std::cos(angle);
+        v.position[1] = radius * std::sin(angle);
+        v.position[2] = 0.0f; // Keep on XY plane
+    };
 
-        auto &renderTarget = *CHECKTHROW(acquireRenderTarget());
-        auto cmd = getFrameCommandBuffer();
+    auto &renderTarget = *CHECKTHROW(acquireRenderTarget());
+    auto cmd = getFrameCommandBuffer();
+    auto frameIndex = getFrameIndex();
 
+    if (window)
+    {
+        // ui first, its widgets edit the vertices committed below
+        NDEEX_TRACE_SCOPE("ui");
         imgui.newFrame();
+        ImGui::ShowDemoWindow();
+        ImGui::Begin("control");
+        auto presentMode = swapchain.getPresentMode();
+        if (ImGui::BeginCombo("present mode", vk::to_string(presentMode).c_str()))
         {
-            beginRecording(cmd);
-            transitionToRender(cmd, renderTarget);
-
-            if (updateVertexBuffer)
+            for (auto mode : swapchain.getSupportedPresentModes())
             {
-                VULKAN_CHECKTHROW(
-                    device.waitForFences(getPrevFrameRenderSync().fence_RenderFinished.get(), true, UINT64_MAX));
-                vertexBuffer.commit(0, allocator, cmd);
+                if (ImGui::Selectable(vk::to_string(mode).c_str(), mode == presentMode))
+                    setPresentMode(mode);
             }
-            {
-                beginRendering(cmd, renderTarget);
-
-                cmd.bindVertexBuffers(0, vertexBuffer.getBufferHandle(), vk::DeviceSize(0));
-                shaderObject.setPrimitiveTopology(vk::PrimitiveTopology::eTriangleFan);
-                shaderObject.setState(cmd);
-                shaderObject.bind(cmd);
-                cmd.draw(vertexBuffer.vertices().size(), 1, 0, 0);
-
-                cmd.bindVertexBuffers(0, vertexBuffer.getBufferHandle(), vk::DeviceSize(0));
-                shaderObject2.setPrimitiveTopology(vk::PrimitiveTopology::eTriangleFan);
-                shaderObject2.setState(cmd);
-                shaderObject2.bind(cmd);
-                cmd.draw(vertexBuffer.vertices().size(), 1, 0, 0);
-                endRendering(cmd);
-            }
-
-            {
+            ImGui::EndCombo();
+        }
+        if (lastPresentLatencyMs)
+            ImGui::Text("present latency %.2f ms", lastPresentLatencyMs.value());
+        auto &vertices = vertexBuffer.vertices();
+        for (size_t i = 0; i < std::min<size_t>(vertices.size(), 8); ++i)
+        {
+            std::pmr::string label(&frameArena);
+            std::format_to(std::back_inserter(label), "pos {}", i);
+            if (ImGui::SliderFloat2(label.c_str(), vertices[i].position.data(), -2.f, +2.f))
+                markVerticesDirty(i, 1);
+        }
+        ImGui::End();
+        gpuProfiler.drawImGuiPanel(&frameArena);
+        metrics.drawImGuiPanel(&frameArena);
+        memoryBudget.drawImGuiPanel(&frameArena);
+    }
+    {
+        NDEEX_TRACE_SCOPE("recording");
+        beginRecording(cmd);
+        // collects what this slot measured framesInFlight frames ago, acquireRenderTarget waited for it
+        gpuProfiler.beginFrame(cmd, frameIndex, currentFrame);
+        if (auto *result = gpuProfiler.getLatestResult();
+            result and !result->zones.empty() and result->frameNumber != lastGpuResultFrame)
+        {
+            lastGpuFrameTimeMs = result->zones.front().durationMs;
+            lastGpuResultFrame = result->frameNumber;
+            gpuFrameTimeMetric.record(lastGpuFrameTimeMs.value());
+        }
+        // before anything reads a buffer handle, a move swaps them
+        defragment(cmd);
 
-                vk::RenderingAttachmentInfo colorAttachment{.imageView = renderTarget.imageView.get(),
-                                                            .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
-                                                            .loadOp = vk::AttachmentLoadOp::eLoad,
-                                                            .storeOp = vk::AttachmentStoreOp::eStore,
-                                                            .clearValue = clearColor};
+        // this frame's copy was last read by the frame that used this slot, which acquireRenderTarget waited on
+        if (recordingThreads > 0)
+        {
+            // upload job -> recording jobs, the recording reads the buffer handle the upload may reallocate
+            JobCounter uploaded;
+            JobCounter recorded;
+            jobSystem.submit([&] { uploadedBytesMetric.add(updateVertices(frameIndex)); }, &uploaded);
+            recorder.record(jobSystem, recorded, &uploaded, frameIndex, getColorFormat(), drawCalls.size(),
+                            [this, frameIndex](vk::CommandBuffer secondary, size_t firstDraw, size_t drawCount) {
+                                recordDraws(secondary, firstDraw, drawCount, frameIndex);
+                            });
+            jobSystem.wait(uploaded);
+            jobSystem.wait(recorded);
+        }
+        else
+        {
+            uploadedBytesMetric.add(updateVertices(frameIndex));
+        }
+        buildRenderGraph(renderTarget, frameIndex, recordingThreads > 0);
+        {
+            GpuProfiler::Scope frameZone(gpuProfiler, cmd, "frame");
+            renderGraph.execute(cmd, &gpuProfiler);
+        }
+        // secondaries were recorded above, inline draws during the graph's execution
+        drawCallsMetric.set(static_cast<double>(drawCommandCount.exchange(0, std::memory_order_relaxed)));
+        gpuProfiler.endFrame(cmd);
+        stopRecording(cmd);
+    }
 
-                vk::RenderingInfo renderingInfo{
-                    .renderArea = {{0, 0}, {window.getInfo().width, window.getInfo().height}},
-                    .layerCount = 1,
-                    .colorAttachmentCount = 1,
-                    .pColorAttachments = &colorAttachment,
-                };
+    submitToQueue(cmd, renderTarget);
+    present(renderTarget);
+    currentFrame++;
+    metrics.update();
+}
 
-                ImGui::ShowDemoWindow();
-                ImGui::Begin("control");
-                for (std::string str = "pos 0"; auto &vertex : vertexBuffer.vertices())
-                {
-                    ImGui::SliderFloat2(str.c_str(), vertex.position.data(), -2.f, +2.f);
-                    str.back()++;
-                }
-                ImGui::End();
-
-                if (updateVertexBuffer)
-                {
-                    VULKAN_CHECKTHROW(
-                        device.waitForFences(getPrevFrameRenderSync().fence_RenderFinished.get(), true, UINT64_MAX));
-                    vertexBuffer.commit(0, allocator, cmd);
-                }
+void Engine::defragment(vk::CommandBuffer cmd)
+{
+    if (!defragmenter)
+        return;
+    // the statistics walk every allocation, a check every few seconds is plenty
+    constexpr size_t checkInterval = 256;
+    if (!defragmenter->isRunning() and currentFrame % checkInterval == 0 and
+        defragmenter->getUnusedRatio() > defragmentUnusedRatio)
+        defragmenter->start();
+    // submitToQueue signals the next value for this frame
+    auto submitValue = timeline.getPendingValue() + 1;
+    defragmentedBytesMetric.add(defragmenter->update(cmd, timeline.getCompletedValue(), submitValue));
+}
 
-                cmd.beginRendering(renderingInfo);
-                imgui.render(cmd);
-                cmd.endRendering();
-            }
-            transitionToPresent(cmd, renderTarget);
-            stopRecording(cmd);
-        }
+// the evictor is asked every frame the heap stays over, a run is reported once when it finished and only started again
+// when the heap's usage changed since then, otherwise an app over budget would defragment back to back
+vk::DeviceSize Engine::evictByDefragmenting(uint32_t heapIndex)
+{
+    auto const &heap = memoryBudget.getHeaps()[heapIndex];
+    // only device local buffers are moved
+    if (!heap.deviceLocal or defragmenter->isRunning())
+        return 0;
+    auto &eviction = defragmentEviction;
+    eviction.usageAfterRun.resize(memoryBudget.getHeaps().size());
+    // settled by whichever heap asks first, the heap that started the run may be back under its headroom and never
+    // ask again. the freed bytes only count for that heap
+    if (eviction.runningHeap)
+    {
+        auto runHeap = std::exchange(eviction.runningHeap, std::nullopt).value();
+        eviction.usageAfterRun[runHeap] = memoryBudget.getHeaps()[runHeap].usage;
+        if (runHeap == heapIndex)
+            return defragmenter->getStats().freedBytes - eviction.freedBytesBefore;
+    }
+    if (eviction.usageAfterRun[heapIndex] == heap.usage)
+        return 0;
+    eviction.runningHeap = heapIndex;
+    eviction.freedBytesBefore = defragmenter->getStats().freedBytes;
+    defragmenter->start();
+    return 0;
+}
 
-        submitToQueue(cmd);
-        present(renderTarget);
-        currentFrame++;
+// the slot of frameIndex is free again, so its copy of the vertices can be written
+size_t Engine::updateVertices(uint32_t frameIndex)
+{
+    if (vertexWriter)
+        vertexWriter(vertexBuffer.map(allocator, streamedVertexCount, frameIndex), currentFrame);
+    auto bytes = vertexBuffer.commit(allocator, *stagingRing, frameIndex, &frameArena);
+    bytes += indexBuffer.commit(allocator, *stagingRing, frameIndex, &frameArena);
+    bytes += geometry.commit(*stagingRing);
+    if (meshScene and !indirectCommands.empty())
+    {
+        // rebuilt every frame, 20 bytes a draw read in place from staging memory
+        auto commands = std::as_bytes(std::span(indirectCommands));
+        frameIndirectCommands = stagingRing->allocate(commands.size(), 4);
+        std::memcpy(frameIndirectCommands.data.data(), commands.data(), commands.size());
+        VULKAN_CHECKTHROW(vmaFlushAllocation(allocator.getHandle(), frameIndirectCommands.allocation,
+                                             frameIndirectCommands.offset, commands.size()));
     }
+    stagingUsedMetric.set(static_cast<double>(stagingRing->getUsedBytes()));
+    return bytes;
 }
 
 void Engine::processEvents()
 {
+    NDEEX_TRACE_FUNCTION();
     SDL_Event *event;
-    while ((event = window.pollAndProcessEvent()))
+    while ((event = window->pollAndProcessEvent()))
     {
         switch (event->type)
         {
         case SDL_EVENT_WINDOW_RESIZED:
-            onWindowResize((uint32_t)event->window.data1, (uint32_t)event->window.data2);
+            requestedExtent = vk::Extent2D{(uint32_t)event->window.data1, (uint32_t)event->window.data2};
             break;
         default:
             break;
@@ -411,16 +963,49 @@ void Engine::processEvents()
     }
 }
 
+// the replaced images and semaphores are retired on the timeline instead of idling the queue
 void Engine::swapChainRecreate()
 {
-    swapchain.recreate({window.getInfo().width, window.getInfo().height}, {graphicsQueueFamilyIndex});
-    graphicsQueue.waitIdle();
-    renderSyncs.recreate(swapchain.size());
+    NDEEX_TRACE_FUNCTION();
+    swapchainRecreationsMetric.add();
+    // frames submitted so far may still use the old objects. presents only wait on the gpu, the binary semaphores
+    // and the old swapchain get framesInFlight more submissions of slack for the present engine to let go of them
+    uint64_t lastUseValue = timeline.getPendingValue();
+    uint64_t presentSafeValue = lastUseValue + framesInFlight;
+    if (window)
+    {
+        deletionQueue.retire(presentSafeValue, swapchain.recreate(extent, {&graphicsQueueFamilyIndex, 1}));
+        pendingPresents.clear(); // their swapchain is retired
+    }
+    else
+    {
+        deletionQueue.retire(lastUseValue, offscreen.recreate(extent, framesInFlight));
+    }
+
+    deletionQueue.push(presentSafeValue, [this, semaphores = std::move(renderFinishedSemaphores)]() mutable {
+        for (auto &semaphore : semaphores)
+            freeSemaphores.push_back(std::move(semaphore));
+    });
+    renderFinishedSemaphores.clear();
+    for (size_t i = 0; i < getRenderTargetCount(); ++i)
+    {
+        renderFinishedSemaphores.push_back(getPooledSemaphore());
+    }
 }
 
+vk::UniqueSemaphore Engine::getPooledSemaphore()
+{
+    if (freeSemaphores.empty())
+        return device.createSemaphoreUnique({});
+    auto semaphore = std::move(freeSemaphores.back());
+    freeSemaphores.pop_back();
+    return semaphore;
+}
+
+// new extent for the next recreate and the viewports that follow it
 void Engine::onWindowResize(uint32_t width, uint32_t height)
 {
-    swapChainRecreate();
+    extent = vk::Extent2D{width, height};
     shaderObject.setViewport(
         {.x = 0, .y = 0, .width = static_cast<float>(width), .height = static_cast<float>(height)});
     shaderObject.setScissor(vk::Rect2D{.offset{.x = 0, .y = 0}, .extent = {.width = width, .height = height}});
@@ -431,18 +1016,4 @@ void Engine::onWindowResize(uint32_t width, uint32_t height)
     shaderObject2.setScissor(vk::Rect2D{.offset{.x = 0, .y = 0}, .extent = {.width = width, .height = height}});
 }
 
-Engine::RenderSyncContainer::RenderSyncContainer(const vk::Device device) : device(device)
-{
-}
-
-void Engine::RenderSyncContainer::recreate(const size_t size)
-{
-    clear();
-    for (uint32_t i = 0; i < size; ++i)
-    {
-        emplace_back(device.createSemaphoreUnique({}), device.createSemaphoreUnique({}),
-                     device.createFenceUnique(vk::FenceCreateInfo{.flags = vk::FenceCreateFlagBits::eSignaled}));
-    }
-}
-
 } // namespace Core
@@ -1,22 +1,202 @@
 #pragma once
 
+#include "CpuTracer.hpp"
+#include "DeletionQueue.hpp"
+#include "FrameArena.hpp"
+#include "GpuProfiler.hpp"
+#include "GpuTimeline.hpp"
 #include "Imgui.hpp"
+#include "JobSystem.hpp"
+#include "MemoryBudget.hpp"
+#include "Metrics.hpp"
+#include "Offscreen.hpp"
+#include "ParallelRecorder.hpp"
+#include "RenderGraph.hpp"
 #include "ShaderObject.hpp"
 #include "Swapchain.hpp"
+#include "TransferQueue.hpp"
 #include "Window.hpp"
+#include "vma/Defragmenter.hpp"
+#include "vma/GeometryArena.hpp"
+#include "vma/IndexBuffer.hpp"
+#include "vma/StagingRing.hpp"
 #include "vma/VertexBuffer.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <span>
+#include <unordered_map>
 
 namespace Core
 {
+struct EngineCreateInfo
+{
+    uint32_t width = 1024;
+    uint32_t height = 800;
+    std::string title = "ndeex";
+    // render into vma allocated offscreen images, no window, swapchain or imgui
+    bool headless = false;
+    // frames the cpu may record ahead of the gpu, more trades latency for throughput
+    uint32_t framesInFlight = 2;
+    // threads recording the draws into secondary command buffers, 0 records them inline into the primary
+    uint32_t recordingThreads = 0;
+    // job system workers besides the calling thread
+    uint32_t workerThreads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    // falls back to what the surface supports, mailbox and immediate trade tear free or power for latency
+    vk::PresentModeKHR presentMode = vk::PresentModeKHR::eFifo;
+    // with present wait support, blocks before sampling input until at most this many presents are queued, 0 off
+    uint32_t maxQueuedPresents = 0;
+    // pipeline statistics in the gpu profiler, only when the device supports them and recordingThreads is 0
+    bool gpuPipelineStatistics = false;
+    // cpu trace of the engine's zones written here while the engine lives, empty disables tracing
+    std::filesystem::path cpuTracePath;
+    // json lines dump of the metrics, one line per second, empty disables it
+    std::filesystem::path metricsPath;
+    // upload memory of each frame in flight shared by all buffers, larger uploads get a temporary buffer
+    vk::DeviceSize stagingBytesPerFrame = 16ull << 20;
+    // static vertex uploads on a dedicated transfer queue family when the device has one
+    bool asyncTransfer = true;
+    // shared vertex and index memory of the meshes added with addMesh, fixed size, 0 disables meshes
+    vk::DeviceSize geometryArenaBytes = 64ull << 20;
+    // the vertex shader reads the vertices through a buffer device address in push constants, no vertex input state
+    bool vertexPulling = false;
+    // device local buffers copied per frame by incremental defragmentation, 0 disables it
+    vk::DeviceSize defragmentBytesPerFrame = 8ull << 20;
+    // share of unused bytes in the allocated blocks that starts a defragmentation run
+    double defragmentUnusedRatio = 0.3;
+    // initial size of the per frame cpu arena, it grows to the largest frame when a frame overflows it
+    size_t frameArenaBytes = size_t{1} << 20;
+    bool frameArenaHugePages = false;
+};
+
 class Engine
 {
   public:
-    Engine();
+    struct Vertex
+    {
+        std::array<float, 2> position;
+        std::array<float, 3> color;
+    };
+    // one draw of the scene, flipped draws go through the shader object with the y flipped viewport.
+    // indexed scenes draw indices [firstVertex, firstVertex + vertexCount)
+    struct SceneDraw
+    {
+        uint32_t firstVertex;
+        uint32_t vertexCount;
+        bool flipped = false;
+    };
+
+    explicit Engine(EngineCreateInfo const &createInfo = {});
     ~Engine();
     void gameloop();
+    void renderFrame();
+
+    // gpu time of the latest frame the profiler collected, nullopt until one finished
+    std::optional<double> getLastGpuFrameTimeMs() const
+    {
+        return lastGpuFrameTimeMs;
+    }
+
+    Metrics &getMetrics()
+    {
+        return metrics;
+    }
+
+    GpuProfiler &getGpuProfiler()
+    {
+        return gpuProfiler;
+    }
+
+    // add evictors for resources that can be dropped or downgraded when a heap gets close to its budget
+    MemoryBudget &getMemoryBudget()
+    {
+        return memoryBudget;
+    }
+
+    // scratch memory of the current frame, everything allocated from it is gone at the start of the next frame
+    FrameArena &getFrameArena()
+    {
+        return frameArena;
+    }
+
+    // engine wide scheduler, cpu work of a frame can be expressed as dependent jobs on it
+    JobSystem &getJobSystem()
+    {
+        return jobSystem;
+    }
+
+    using VertexMode = vma::VertexBuffer<Vertex>::Mode;
+    // fills the mapped vertices of a streamed scene, all of them every frame
+    using VertexWriter = std::function<void(std::span<Vertex> vertices, uint64_t frameNumber)>;
+
+    // replaces what is drawn, call between frames. topology applies to every draw.
+    // eStatic frees the cpu copy once uploaded, sceneVertices() is empty from then on
+    void setScene(std::vector<Vertex> vertices, std::vector<SceneDraw> const &draws,
+                  vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList,
+                  VertexMode mode = VertexMode::eDynamic);
+    // draws index the vertices, see mesh::deduplicate and mesh::optimize to build and order them
+    void setIndexedScene(std::vector<Vertex> vertices, std::vector<uint32_t> indices,
+                         std::vector<SceneDraw> const &draws,
+                         vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList,
+                         VertexMode mode = VertexMode::eDynamic);
+    // no cpu copy, writer fills vertexCount vertices straight into the mapped buffer of each frame before recording
+    void setStreamedScene(size_t vertexCount, std::vector<SceneDraw> const &draws, VertexWriter writer,
+                          vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList);
+    // vertices and indices of one mesh in the shared geometry arena, uploaded by the next frame
+    uint32_t addMesh(std::span<Vertex const> vertices, std::span<uint32_t const> indices);
+    // the mesh must not be drawn anymore, its range is reused once the frames in flight are done with it
+    void removeMesh(uint32_t mesh);
+    struct MeshDraw
+    {
+        uint32_t mesh;
+        bool flipped = false;
+    };
+    // draws added meshes, all with one vertex and index buffer bind and one multi draw indirect per shader object
+    // run, so keep the draws of each shader object together. replaces what is drawn like setScene
+    void setMeshScene(std::vector<MeshDraw> const &draws,
+                      vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList);
+    // edit in place and report the changed vertices with markVerticesDirty, uploaded by the next frame
+    std::vector<Vertex> &sceneVertices()
+    {
+        return vertexBuffer.vertices();
+    }
+    void markVerticesDirty(size_t firstVertex = 0, size_t vertexCount = vma::VertexBuffer<Vertex>::toEnd)
+    {
+        vertexBuffer.markDirty(firstVertex, vertexCount);
+    }
+
+    // like a window resize event, takes effect at the start of the next frame and only the last request counts
+    void resize(uint32_t width, uint32_t height)
+    {
+        requestedExtent = vk::Extent2D{width, height};
+    }
+
+    // takes effect at the start of the next frame
+    void setPresentMode(vk::PresentModeKHR presentMode)
+    {
+        requestedPresentMode = presentMode;
+    }
+
+    // input sampling to the present being visible, measured with present wait. nullopt when unsupported
+    std::optional<double> getLastPresentLatencyMs() const
+    {
+        return lastPresentLatencyMs;
+    }
+
+    // counts frame submissions, subsystems can compare against it to see what the gpu is done with
+    GpuTimeline &getTimeline()
+    {
+        return timeline;
+    }
 
   private:
     void processEvents();
+    void applySwapchainRequests();
+    void waitForQueuedPresents();
     void onWindowResize(uint32_t width, uint32_t height);
 
     void initCoreHandles();
@@ -24,65 +204,74 @@ class Engine
     void initSwapchain();
     void initImGui();
     void initVertexBuffer();
+    void resetVertexBuffer(VertexMode mode);
+    vma::VertexBuffer<Vertex>::Fetch getVertexFetch() const
+    {
+        return vertexPulling ? vma::VertexBuffer<Vertex>::Fetch::eDeviceAddress
+                             : vma::VertexBuffer<Vertex>::Fetch::eBound;
+    }
+    void setDraws(std::vector<SceneDraw> const &draws, vk::PrimitiveTopology topology);
+    size_t updateVertices(uint32_t frameIndex);
+    void defragment(vk::CommandBuffer cmd);
+    vk::DeviceSize evictByDefragmenting(uint32_t heapIndex);
     void initShaderObjects();
 
+    void initFrames();
     void swapChainRecreate();
+    vk::UniqueSemaphore getPooledSemaphore();
+    std::size_t getRenderTargetCount()
+    {
+        return window ? swapchain.size() : offscreen.size();
+    }
+    vk::Format getColorFormat()
+    {
+        return window ? swapchain.getFormat() : offscreen.getFormat();
+    }
 
     Swapchain::RenderTarget *acquireRenderTarget(std::chrono::milliseconds timeout = std::chrono::seconds{1});
     void beginRecording(vk::CommandBuffer cmd);
-    void transitionToRender(vk::CommandBuffer cmd, Swapchain::RenderTarget &renderTarget);
-    void beginRendering(vk::CommandBuffer cmd, Swapchain::RenderTarget &renderTarget);
+    void beginRendering(vk::CommandBuffer cmd, Swapchain::RenderTarget &renderTarget, vk::RenderingFlags flags = {});
+    // both add the draw commands they record to drawCommandCount
+    void recordDraws(vk::CommandBuffer cmd, size_t firstDraw, size_t drawCount, uint32_t frameIndex);
+    void recordMeshDraws(vk::CommandBuffer cmd, size_t firstDraw, size_t drawCount);
     void endRendering(vk::CommandBuffer cmd);
-    void transitionToPresent(vk::CommandBuffer cmd, Swapchain::RenderTarget &renderTarget);
+    void buildRenderGraph(Swapchain::RenderTarget &renderTarget, uint32_t frameIndex, bool secondariesRecorded);
     void stopRecording(vk::CommandBuffer cmd);
-    void submitToQueue(vk::CommandBuffer cmd);
+    void submitToQueue(vk::CommandBuffer cmd, Swapchain::RenderTarget &renderTarget);
     void present(Swapchain::RenderTarget &renderTarget);
 
-    struct RenderSync
+    // everything one frame in flight needs, reused once the timeline passes the frame's submitValue
+    struct FrameResources
     {
+        vk::UniqueCommandBuffer commandBuffer;
         vk::UniqueSemaphore sem_ImageAcquired;
-        vk::UniqueSemaphore sem_RenderFinished;
-        vk::UniqueFence fence_RenderFinished;
+        uint64_t submitValue = 0; // timeline value signaled by the frame's last submission
     };
-    struct RenderSyncContainer : std::vector<RenderSync>
-    {
-        vk::Device device;
-
-        RenderSyncContainer() = default;
-        explicit RenderSyncContainer(const vk::Device device);
-        RenderSyncContainer(const RenderSyncContainer &) = delete;
-        RenderSyncContainer &operator=(const RenderSyncContainer &) = delete;
-        RenderSyncContainer(RenderSyncContainer &&other) = default;
-        RenderSyncContainer &operator=(RenderSyncContainer &&other) = default;
 
-        void recreate(const size_t size);
-    };
-
-    RenderSync &getFrameRenderSync()
+    uint32_t getFrameIndex() const
     {
-        return renderSyncs.at(currentFrame % swapchain.size());
+        return static_cast<uint32_t>(currentFrame % frames.size());
     }
-    RenderSync &getPrevFrameRenderSync()
+    FrameResources &getFrame()
     {
-        return renderSyncs.at((currentFrame + swapchain.size() - 1) % swapchain.size());
+        return frames.at(getFrameIndex());
     }
     vk::CommandBuffer getFrameCommandBuffer()
     {
-        return commandBuffers.at(currentFrame % swapchain.size()).get();
-    }
-    vk::CommandBuffer getPrevFrameCommandBuffer()
-    {
-        return commandBuffers.at((currentFrame + swapchain.size() - 1) % swapchain.size()).get();
+        return getFrame().commandBuffer.get();
     }
 
     std::size_t currentFrame = 0;
+    vk::Extent2D extent;
+    // the tracer is process wide, only the engine that started it stops it
+    bool cpuTraceStarted = false;
 
     vk::ClearValue clearColor{};
     vk::detail::DynamicLoader dl;
     vma::Allocator allocator;
-    Core::Window window;
+    std::optional<Core::Window> window; // nullopt when headless
     vk::Instance vkInstance;
-    VkSurfaceKHR surface;
+    VkSurfaceKHR surface{};
     vk::PhysicalDevice physicalDevice;
     uint32_t graphicsQueueFamilyIndex;
 #if defined(DEBUG)
@@ -90,20 +279,102 @@ class Engine
 #endif
     vk::Device device;
     vk::Queue graphicsQueue;
+    bool asyncTransfer;
+    std::optional<uint32_t> transferQueueFamilyIndex; // dedicated family, nullopt uploads on the graphics queue
+    std::optional<TransferQueue> transferQueue;
+    std::optional<uint64_t> pendingTransferWait; // transfer timeline value the next graphics submission waits on
     Swapchain swapchain;
+    Offscreen offscreen;
     DearImgui imgui;
-    RenderSyncContainer renderSyncs;
+    GpuTimeline timeline;
     vk::UniqueCommandPool commandPool;
-    std::vector<vk::UniqueCommandBuffer> commandBuffers;
+    uint32_t framesInFlight;
+    std::vector<FrameResources> frames;
+    // signaled by a frame's submit and waited on by the present of the image, so one per render target
+    std::vector<vk::UniqueSemaphore> renderFinishedSemaphores;
+    std::vector<vk::UniqueSemaphore> freeSemaphores; // recycled binary semaphores, unsignaled
+    DeletionQueue deletionQueue;
+    std::optional<vma::StagingRing> stagingRing; // not movable, emplaced once the allocator exists
+    std::optional<vma::Defragmenter> defragmenter; // nullopt when disabled
+    double defragmentUnusedRatio;
+    // the defragmentation run the memory budget started and per heap the usage when its last run finished
+    struct DefragmentEviction
+    {
+        std::optional<uint32_t> runningHeap;
+        vk::DeviceSize freedBytesBefore = 0;
+        std::vector<std::optional<vk::DeviceSize>> usageAfterRun;
+    };
+    DefragmentEviction defragmentEviction;
+    MemoryBudget memoryBudget;
+    std::optional<vk::Extent2D> requestedExtent; // latest resize since the last frame
+    Metrics metrics;
+    // looked up once, the registry keeps them at a fixed address
+    Histogram &frameTimeMetric = metrics.histogram("frame_ms", 0.001);
+    Histogram &gpuFrameTimeMetric = metrics.histogram("gpu_frame_ms", 0.001);
+    Histogram &acquireWaitMetric = metrics.histogram("acquire_wait_ms", 0.001);
+    Histogram &frameSlotWaitMetric = metrics.histogram("frame_slot_wait_ms", 0.001);
+    Counter &uploadedBytesMetric = metrics.counter("uploaded_bytes");
+    Counter &swapchainRecreationsMetric = metrics.counter("swapchain_recreations");
+    Gauge &drawCallsMetric = metrics.gauge("draw_calls"); // api draw commands, a multi draw counts once
+    std::atomic<uint32_t> drawCommandCount = 0;          // of the frame being recorded, from all recording threads
+    Gauge &stagingUsedMetric = metrics.gauge("staging_used_bytes");
+    Counter &defragmentedBytesMetric = metrics.counter("defragmented_bytes");
+    Gauge &frameArenaBytesMetric = metrics.gauge("frame_arena_bytes");
+    std::optional<std::chrono::steady_clock::time_point> lastFrameStart;
+    uint64_t lastGpuResultFrame = ~0ull; // frame number of the last profiler result recorded
+    bool pipelineStatisticsEnabled;
+    GpuProfiler gpuProfiler;
+    std::optional<double> lastGpuFrameTimeMs;
+    uint32_t recordingThreads;
+    JobSystem jobSystem;
+    ParallelRecorder recorder;
+
+    // presents with present wait whose visibility was not observed yet
+    struct PendingPresent
+    {
+        uint64_t presentId;
+        std::chrono::steady_clock::time_point inputSampleTime;
+    };
+    vk::PresentModeKHR initialPresentMode;
+    std::optional<vk::PresentModeKHR> requestedPresentMode;
+    uint32_t maxQueuedPresents;
+    bool presentWaitSupported = false;
+    bool memoryBudgetSupported = false; // VK_EXT_memory_budget enabled, vma reports the driver's budget
+    std::deque<PendingPresent> pendingPresents;
+    std::chrono::steady_clock::time_point inputSampleTime;
+    std::optional<double> lastPresentLatencyMs;
+    FrameArena frameArena;
+    RenderGraph renderGraph; // rebuilt every frame from the frame arena
     ShaderObject shaderObject;
     ShaderObject shaderObject2;
 
-    struct Vertex
+    struct DrawCall
     {
-        std::array<float, 2> position;
-        std::array<float, 3> color;
+        ShaderObject *shaderObject;
+        uint32_t firstVertex;
+        uint32_t vertexCount;
     };
+    std::vector<DrawCall> drawCalls;
+
     vma::VertexBuffer<Vertex> vertexBuffer;
+    vma::IndexBuffer<uint32_t> indexBuffer;
+    bool sceneIndexed = false;
+    bool vertexPulling;
+    VertexWriter vertexWriter; // streamed scenes only
+    size_t streamedVertexCount = 0;
+
+    struct Mesh
+    {
+        vma::GeometryArena::Range vertices;
+        vma::GeometryArena::Range indices;
+    };
+    vma::GeometryArena geometry;
+    std::unordered_map<uint32_t, Mesh> meshes;
+    uint32_t nextMeshId = 0;
+    bool meshScene = false;
+    std::vector<vk::DrawIndexedIndirectCommand> indirectCommands; // of the mesh scene, parallel to drawCalls
+    vma::StagingRing::Allocation frameIndirectCommands{};        // the copy of this frame the draws read
+    uint32_t maxDrawIndirectCount = 1;                            // 1 without multiDrawIndirect
     vk::UniqueDeviceMemory vertexBufferMemory;
 };
 } // namespace Core
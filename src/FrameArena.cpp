@@ -0,0 +1,98 @@
+#include "FrameArena.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <new>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace Core
+{
+namespace
+{
+constexpr size_t hugePageSize = size_t{2} << 20;
+constexpr std::align_val_t blockAlignment{64};
+} // namespace
+
+FrameArena::FrameArena(size_t capacity, bool hugePages_)
+    : block(allocateBlock(std::max<size_t>(capacity, 4096), hugePages_)), hugePages(hugePages_)
+{
+}
+
+FrameArena::~FrameArena()
+{
+    reset();
+    freeBlock(block);
+}
+
+FrameArena::Block FrameArena::allocateBlock(size_t size, bool hugePages)
+{
+#if defined(__linux__)
+    if (hugePages)
+    {
+        // explicit huge pages need a reserved pool, transparent ones are the fallback
+        size = (size + hugePageSize - 1) / hugePageSize * hugePageSize;
+        void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (data == MAP_FAILED)
+        {
+            data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (data == MAP_FAILED)
+                throw std::bad_alloc();
+            madvise(data, size, MADV_HUGEPAGE);
+        }
+        return Block{static_cast<std::byte *>(data), size, true};
+    }
+#endif
+    // other platforms get regular pages
+    return Block{static_cast<std::byte *>(::operator new(size, blockAlignment)), size, false};
+}
+
+void FrameArena::freeBlock(Block const &block)
+{
+#if defined(__linux__)
+    if (block.mapped)
+    {
+        munmap(block.data, block.size);
+        return;
+    }
+#endif
+    ::operator delete(block.data, blockAlignment);
+}
+
+void *FrameArena::do_allocate(size_t bytes, size_t alignment)
+{
+    auto base = reinterpret_cast<uintptr_t>(block.data);
+    auto offset = cursor.load(std::memory_order_relaxed);
+    size_t begin;
+    do
+    {
+        begin = ((base + offset + alignment - 1) & ~(alignment - 1)) - base;
+        if (begin + bytes > block.size)
+        {
+            std::scoped_lock lock(overflowMutex);
+            void *data = std::pmr::new_delete_resource()->allocate(bytes, alignment);
+            overflow.push_back(Overflow{data, bytes, alignment});
+            overflowBytes.fetch_add(bytes, std::memory_order_relaxed);
+            return data;
+        }
+    } while (!cursor.compare_exchange_weak(offset, begin + bytes, std::memory_order_relaxed));
+    return block.data + begin;
+}
+
+void FrameArena::reset()
+{
+    auto used = getUsedBytes();
+    for (auto const &entry : overflow)
+        std::pmr::new_delete_resource()->deallocate(entry.data, entry.bytes, entry.alignment);
+    // the block of the next frames fits this one, the overflow was a one frame cost
+    if (!overflow.empty())
+    {
+        freeBlock(block);
+        block = allocateBlock(std::bit_ceil(used), hugePages);
+    }
+    overflow.clear();
+    overflowBytes.store(0, std::memory_order_relaxed);
+    cursor.store(0, std::memory_order_relaxed);
+}
+} // namespace Core
\ No newline at end of file
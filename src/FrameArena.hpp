@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+namespace Core
+{
+// bump allocator for data that lives at most one frame on the cpu, strings, barriers and scratch vectors of the
+// frame loop. std::pmr containers take it as their memory resource, deallocate does nothing and reset() at the start
+// of the next frame takes everything back at once. allocating is thread safe. what does not fit the block comes
+// from the upstream resource until the reset, which then grows the block to the frame's high water mark
+class FrameArena : public std::pmr::memory_resource
+{
+  public:
+    // hugePages backs the block with huge pages where the os allows it, large frames touch fewer tlb entries
+    explicit FrameArena(size_t capacity = size_t{1} << 20, bool hugePages = false);
+    FrameArena(FrameArena const &) = delete;
+    FrameArena &operator=(FrameArena const &) = delete;
+    ~FrameArena() override;
+
+    // everything allocated before is gone, containers using it must have been destroyed
+    void reset();
+
+    // since the last reset, overflow included
+    size_t getUsedBytes() const
+    {
+        return cursor.load(std::memory_order_relaxed) + overflowBytes.load(std::memory_order_relaxed);
+    }
+    size_t getCapacity() const
+    {
+        return block.size;
+    }
+
+  private:
+    struct Block
+    {
+        std::byte *data = nullptr;
+        size_t size = 0;
+        bool mapped = false; // from mmap, otherwise from operator new
+    };
+    struct Overflow
+    {
+        void *data;
+        size_t bytes;
+        size_t alignment;
+    };
+    static Block allocateBlock(size_t size, bool hugePages);
+    static void freeBlock(Block const &block);
+
+    void *do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void *, size_t, size_t) override
+    {
+    }
+    bool do_is_equal(std::pmr::memory_resource const &other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    Block block;
+    bool hugePages;
+    std::atomic<size_t> cursor = 0;
+    std::atomic<size_t> overflowBytes = 0;
+    std::mutex overflowMutex;
+    std::vector<Overflow> overflow;
+};
+} // namespace Core
\ No newline at end of file
@@ -0,0 +1,225 @@
+#include "GpuProfiler.hpp"
+#include "helpers.hpp"
+#include "imgui.h"
+#include <format>
+#include <fstream>
+#include <print>
+
+namespace
+{
+constexpr vk::QueryPipelineStatisticFlags statisticFlags =
+    vk::QueryPipelineStatisticFlagBits::eInputAssemblyVertices |
+    vk::QueryPipelineStatisticFlagBits::eInputAssemblyPrimitives |
+    vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations |
+    vk::QueryPipelineStatisticFlagBits::eClippingInvocations | vk::QueryPipelineStatisticFlagBits::eClippingPrimitives |
+    vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations;
+constexpr std::array statisticNames{"ia vertices",      "ia primitives",   "vs invocations",
+                                    "clip invocations", "clip primitives", "fs invocations"};
+} // namespace
+
+GpuProfiler::GpuProfiler(vk::PhysicalDevice physicalDevice, vk::Device device_, uint32_t queueFamilyIndex,
+                         uint32_t framesInFlight, bool pipelineStatistics, uint32_t maxZonesPerFrame_)
+    : device(device_), maxZonesPerFrame(maxZonesPerFrame_), slots(framesInFlight)
+{
+    auto validBits = physicalDevice.getQueueFamilyProperties().at(queueFamilyIndex).timestampValidBits;
+    if (validBits == 0)
+    {
+        std::println("no timestamp support on the queue, gpu profiler disabled");
+        return;
+    }
+    timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    timestampPeriodNs = physicalDevice.getProperties().limits.timestampPeriod;
+    timestampPool = device.createQueryPoolUnique(vk::QueryPoolCreateInfo{
+        .queryType = vk::QueryType::eTimestamp, .queryCount = 2 * maxZonesPerFrame * framesInFlight});
+    if (pipelineStatistics)
+        statisticsPool = device.createQueryPoolUnique(vk::QueryPoolCreateInfo{
+            .queryType = vk::QueryType::ePipelineStatistics,
+            .queryCount = framesInFlight,
+            .pipelineStatistics = statisticFlags,
+        });
+    for (auto &slot : slots)
+    {
+        slot.zoneNames.reserve(maxZonesPerFrame);
+        slot.zoneDepths.reserve(maxZonesPerFrame);
+    }
+    timestamps.resize(2 * maxZonesPerFrame);
+    history.reserve(historySize);
+}
+
+void GpuProfiler::beginFrame(vk::CommandBuffer cmd, uint32_t frameIndex, uint64_t frameNumber)
+{
+    if (!isEnabled())
+        return;
+
+    auto &slot = slots.at(frameIndex);
+    if (slot.written)
+        collect(slot, frameIndex);
+    slot.zoneNames.clear();
+    slot.zoneDepths.clear();
+    slot.frameNumber = frameNumber;
+    slot.written = true;
+    currentFrameIndex = frameIndex;
+    currentDepth = 0;
+
+    cmd.resetQueryPool(timestampPool.get(), firstQuery(frameIndex), 2 * maxZonesPerFrame);
+    if (statisticsPool)
+    {
+        cmd.resetQueryPool(statisticsPool.get(), frameIndex, 1);
+        cmd.beginQuery(statisticsPool.get(), frameIndex, {});
+    }
+}
+
+void GpuProfiler::endFrame(vk::CommandBuffer cmd)
+{
+    if (statisticsPool)
+        cmd.endQuery(statisticsPool.get(), currentFrameIndex);
+}
+
+uint32_t GpuProfiler::beginZone(vk::CommandBuffer cmd, std::string_view name)
+{
+    if (!isEnabled())
+        return invalidZone;
+    auto &slot = slots[currentFrameIndex];
+    if (slot.zoneNames.size() >= maxZonesPerFrame)
+        return invalidZone;
+
+    auto zone = static_cast<uint32_t>(slot.zoneNames.size());
+    slot.zoneNames.push_back(intern(name));
+    slot.zoneDepths.push_back(currentDepth++);
+    // all commands: the zone starts once the work recorded before it is done
+    cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, timestampPool.get(),
+                        firstQuery(currentFrameIndex) + 2 * zone);
+    return zone;
+}
+
+void GpuProfiler::endZone(vk::CommandBuffer cmd, uint32_t zone)
+{
+    if (zone == invalidZone)
+        return;
+    --currentDepth;
+    cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, timestampPool.get(),
+                        firstQuery(currentFrameIndex) + 2 * zone + 1);
+}
+
+// no wait flag, an incomplete slot (e.g. a zone left open) is dropped instead of stalling
+void GpuProfiler::collect(FrameSlot &slot, uint32_t frameIndex)
+{
+    auto zoneCount = static_cast<uint32_t>(slot.zoneNames.size());
+    if (zoneCount == 0)
+        return;
+
+    auto result = device.getQueryPoolResults(timestampPool.get(), firstQuery(frameIndex), 2 * zoneCount,
+                                             2 * zoneCount * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t),
+                                             vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess)
+        return;
+
+    auto toMs = [this](uint64_t from, uint64_t to) {
+        return static_cast<double>((to - from) & timestampMask) * timestampPeriodNs / 1e6;
+    };
+    FrameResult *next;
+    if (history.size() < historySize)
+    {
+        next = &history.emplace_back();
+    }
+    else
+    {
+        next = &history[historyBegin];
+        historyBegin = (historyBegin + 1) % history.size();
+    }
+    auto &frameResult = *next;
+    frameResult.frameNumber = slot.frameNumber;
+    frameResult.beginNs = static_cast<uint64_t>(static_cast<double>(timestamps[0]) * timestampPeriodNs);
+    frameResult.zones.clear();
+    frameResult.pipelineStatistics.reset();
+    for (uint32_t i = 0; i < zoneCount; ++i)
+    {
+        frameResult.zones.push_back(Zone{.name = slot.zoneNames[i],
+                                         .depth = slot.zoneDepths[i],
+                                         .beginMs = toMs(timestamps[0], timestamps[2 * i]),
+                                         .durationMs = toMs(timestamps[2 * i], timestamps[2 * i + 1])});
+    }
+    if (statisticsPool)
+    {
+        PipelineStatistics statistics{};
+        if (device.getQueryPoolResults(statisticsPool.get(), frameIndex, 1, sizeof(statistics), statistics.data(),
+                                       sizeof(statistics), vk::QueryResultFlagBits::e64) == vk::Result::eSuccess)
+            frameResult.pipelineStatistics = statistics;
+    }
+}
+
+std::string_view GpuProfiler::intern(std::string_view name)
+{
+    auto found = names.find(name);
+    if (found == names.end())
+        found = names.emplace(name).first;
+    return *found;
+}
+
+void GpuProfiler::drawImGuiPanel(std::pmr::memory_resource *memory)
+{
+    ImGui::Begin("gpu profiler");
+    if (!isEnabled())
+    {
+        ImGui::Text("no timestamp support");
+        ImGui::End();
+        return;
+    }
+
+    if (auto *latest = getLatestResult())
+    {
+        // first zone is the outermost, its duration is the frame's gpu time
+        std::pmr::vector<float> frameTimes(memory);
+        frameTimes.reserve(history.size());
+        for (size_t i = 0; i < history.size(); ++i)
+        {
+            auto const &frame = getHistory(i);
+            if (!frame.zones.empty())
+                frameTimes.push_back(static_cast<float>(frame.zones.front().durationMs));
+        }
+        ImGui::PlotLines("frame ms", frameTimes.data(), static_cast<int>(frameTimes.size()));
+
+        ImGui::Text("frame %llu", static_cast<unsigned long long>(latest->frameNumber));
+        for (auto const &zone : latest->zones)
+            ImGui::Text("%*s%.*s %.3f ms", static_cast<int>(2 * zone.depth), "", static_cast<int>(zone.name.size()),
+                        zone.name.data(), zone.durationMs);
+        if (latest->pipelineStatistics)
+        {
+            for (size_t i = 0; i < statisticNames.size(); ++i)
+                ImGui::Text("%s %llu", statisticNames[i],
+                            static_cast<unsigned long long>(latest->pipelineStatistics.value()[i]));
+        }
+    }
+    if (ImGui::Button("export chrome trace"))
+        exportChromeTrace("gpu_trace.json");
+    ImGui::End();
+}
+
+void GpuProfiler::exportChromeTrace(std::filesystem::path const &path) const
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::println("could not open {} for the gpu trace", path.string());
+        return;
+    }
+
+    uint64_t originNs = history.empty() ? 0 : getHistory(0).beginNs;
+    file << "{\"traceEvents\":[";
+    bool first = true;
+    for (size_t i = 0; i < history.size(); ++i)
+    {
+        auto const &frame = getHistory(i);
+        double frameBeginUs = static_cast<double>(frame.beginNs - originNs) / 1e3;
+        for (auto const &zone : frame.zones)
+        {
+            file << std::format("{}{{\"name\":\"{}\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":\"gpu\","
+                                "\"ts\":{:.3f},\"dur\":{:.3f},\"args\":{{\"frame\":{}}}}}",
+                                first ? "" : ",\n", helpers::escapeJson(zone.name), frameBeginUs + zone.beginMs * 1e3,
+                                zone.durationMs * 1e3, frame.frameNumber);
+            first = false;
+        }
+    }
+    file << "]}\n";
+    std::println("gpu trace of {} frames written to {}", history.size(), path.string());
+}
\ No newline at end of file
@@ -0,0 +1,136 @@
+#pragma once
+#include "Vulkan.hpp"
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+// timestamp zones recorded into the frame's command buffer. every frame in flight owns a slice of the query pools,
+// the slice is read back when the frame slot comes around again, so reading never waits on the gpu
+class GpuProfiler
+{
+  public:
+    struct Zone
+    {
+        std::string_view name; // interned, lives as long as the profiler
+        uint32_t depth;
+        double beginMs; // from the start of the frame
+        double durationMs;
+    };
+    // input assembly vertices and primitives, vertex shader invocations, clipping invocations and primitives,
+    // fragment shader invocations
+    using PipelineStatistics = std::array<uint64_t, 6>;
+    struct FrameResult
+    {
+        uint64_t frameNumber = 0;
+        uint64_t beginNs = 0; // gpu clock, only comparable between frames of the same device
+        std::vector<Zone> zones;
+        std::optional<PipelineStatistics> pipelineStatistics;
+    };
+
+    // ends the zone when leaving the scope
+    class Scope
+    {
+      public:
+        Scope(GpuProfiler &profiler_, vk::CommandBuffer cmd_, std::string_view name)
+            : profiler(profiler_), cmd(cmd_), zone(profiler.beginZone(cmd, name))
+        {
+        }
+        Scope(Scope const &) = delete;
+        Scope &operator=(Scope const &) = delete;
+        ~Scope()
+        {
+            profiler.endZone(cmd, zone);
+        }
+
+      private:
+        GpuProfiler &profiler;
+        vk::CommandBuffer cmd;
+        uint32_t zone;
+    };
+
+    GpuProfiler() = default;
+    // disabled when the queue has no timestamp support. pipelineStatistics needs the pipelineStatisticsQuery
+    // feature enabled and must stay off when secondaries are executed inside the frame
+    GpuProfiler(vk::PhysicalDevice physicalDevice, vk::Device device, uint32_t queueFamilyIndex,
+                uint32_t framesInFlight, bool pipelineStatistics = false, uint32_t maxZonesPerFrame = 64);
+
+    bool isEnabled() const
+    {
+        return bool(timestampPool);
+    }
+
+    // the frame slot must be done on the gpu: collects what it recorded last time and resets its queries
+    void beginFrame(vk::CommandBuffer cmd, uint32_t frameIndex, uint64_t frameNumber);
+    void endFrame(vk::CommandBuffer cmd);
+
+    // zones nest, returns an id for endZone
+    uint32_t beginZone(vk::CommandBuffer cmd, std::string_view name);
+    void endZone(vk::CommandBuffer cmd, uint32_t zone);
+
+    // latest frame the gpu finished, nullptr before the first one
+    FrameResult const *getLatestResult() const
+    {
+        return history.empty() ? nullptr : &getHistory(history.size() - 1);
+    }
+
+    void drawImGuiPanel(std::pmr::memory_resource *memory = std::pmr::get_default_resource());
+    // the collected history in chrome://tracing / perfetto json format
+    void exportChromeTrace(std::filesystem::path const &path) const;
+
+  private:
+    static constexpr uint32_t invalidZone = ~0u;
+    static constexpr size_t historySize = 240;
+
+    struct NameHash
+    {
+        using is_transparent = void;
+        size_t operator()(std::string_view name) const
+        {
+            return std::hash<std::string_view>{}(name);
+        }
+    };
+
+    struct FrameSlot
+    {
+        std::vector<std::string_view> zoneNames;
+        std::vector<uint32_t> zoneDepths;
+        uint64_t frameNumber = 0;
+        bool written = false;
+    };
+
+    void collect(FrameSlot &slot, uint32_t frameIndex);
+    std::string_view intern(std::string_view name);
+    // i-th oldest result
+    FrameResult const &getHistory(size_t i) const
+    {
+        return history[(historyBegin + i) % history.size()];
+    }
+    uint32_t firstQuery(uint32_t frameIndex) const
+    {
+        return frameIndex * maxZonesPerFrame * 2;
+    }
+
+    vk::Device device;
+    vk::UniqueQueryPool timestampPool; // begin and end per zone
+    vk::UniqueQueryPool statisticsPool; // one per frame
+    double timestampPeriodNs = 0.0;
+    uint64_t timestampMask = ~0ull;
+    uint32_t maxZonesPerFrame = 0;
+    std::vector<FrameSlot> slots;
+    uint32_t currentFrameIndex = 0;
+    uint32_t currentDepth = 0;
+    // zone names repeat every frame, the slots and results refer to one copy of each. nodes keep their address
+    std::unordered_set<std::string, NameHash, std::equal_to<>> names;
+    std::vector<uint64_t> timestamps; // read back scratch, sized for a full slot
+    // ring of the last historySize results, the oldest at historyBegin once full. the oldest result is overwritten
+    // by the next one, so collecting allocates nothing once the zone vectors reached their size
+    std::vector<FrameResult> history;
+    size_t historyBegin = 0;
+};
\ No newline at end of file
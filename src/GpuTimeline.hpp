@@ -0,0 +1,65 @@
+#pragma once
+#include "Vulkan.hpp"
+#include "helpers_vulkan.hpp"
+#include <chrono>
+#include <cstdint>
+
+// device wide timeline semaphore counting queue submissions.
+// a submission signals nextValue(), anyone holding that value can later check or wait for the gpu to pass it
+class GpuTimeline
+{
+  public:
+    GpuTimeline() = default;
+    explicit GpuTimeline(vk::Device device_) : device(device_)
+    {
+        vk::SemaphoreTypeCreateInfo typeCreateInfo{.semaphoreType = vk::SemaphoreType::eTimeline, .initialValue = 0};
+        semaphore = device.createSemaphoreUnique(vk::SemaphoreCreateInfo{.pNext = &typeCreateInfo});
+    }
+
+    // value the next submission has to signal
+    uint64_t nextValue()
+    {
+        return ++pendingValue;
+    }
+
+    // last value handed out to a submission
+    uint64_t getPendingValue() const
+    {
+        return pendingValue;
+    }
+
+    // queries the semaphore, cheap and never blocks
+    uint64_t getCompletedValue()
+    {
+        completedValue = device.getSemaphoreCounterValue(semaphore.get());
+        return completedValue;
+    }
+
+    bool isComplete(uint64_t value)
+    {
+        return value <= completedValue or value <= getCompletedValue();
+    }
+
+    // blocks until the gpu has passed value, throws on timeout
+    void wait(uint64_t value, std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max())
+    {
+        if (value <= completedValue)
+            return;
+
+        vk::Semaphore waitSemaphore = semaphore.get();
+        vk::SemaphoreWaitInfo waitInfo{.semaphoreCount = 1, .pSemaphores = &waitSemaphore, .pValues = &value};
+        VULKAN_CHECKTHROW(device.waitSemaphores(waitInfo, static_cast<uint64_t>(timeout.count())));
+        completedValue = value;
+    }
+
+    vk::Semaphore getHandle()
+    {
+        return semaphore.get();
+    }
+
+  private:
+    vk::Device device;
+    vk::UniqueSemaphore semaphore;
+    uint64_t pendingValue = 0;
+    uint64_t completedValue = 0;
+};
\ No newline at end of file
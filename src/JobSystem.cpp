@@ -0,0 +1,183 @@
+#include "JobSystem.hpp"
+#include "CpuTracer.hpp"
+#include <string>
+#include <utility>
+
+namespace Core
+{
+namespace
+{
+// queue the calling thread owns in the job system it works for
+thread_local JobSystem const *tlsJobSystem = nullptr;
+thread_local uint32_t tlsQueueIndex = 0;
+} // namespace
+
+JobSystem::JobSystem(uint32_t workerCount)
+{
+    for (uint32_t i = 0; i < workerCount + 1; ++i)
+    {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+    for (uint32_t i = 0; i < workerCount; ++i)
+    {
+        workers.emplace_back([this, i] { workerLoop(i + 1); });
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard lock(sleepMutex);
+        stopping = true;
+    }
+    sleepCondition.notify_all();
+    workers.clear(); // joins
+}
+
+void JobSystem::submit(Job job, JobCounter *signal, JobCounter *dependency)
+{
+    if (signal)
+        signal->pending.fetch_add(1, std::memory_order_relaxed);
+
+    Task task{std::move(job), signal};
+    if (dependency)
+    {
+        // checked under the dependency's lock, finish() takes the same lock after the last decrement
+        std::lock_guard lock(dependency->mutex);
+        if (not dependency->isDone())
+        {
+            dependency->waiters.push_back(std::move(task));
+            return;
+        }
+    }
+    push(std::move(task));
+}
+
+void JobSystem::wait(JobCounter &counter)
+{
+    while (not counter.isDone())
+    {
+        if (not tryRunOne())
+            std::this_thread::yield();
+    }
+
+    std::lock_guard lock(counter.mutex);
+    if (counter.error)
+        std::rethrow_exception(std::exchange(counter.error, nullptr));
+}
+
+void JobSystem::workerLoop(uint32_t queueIndex)
+{
+    tlsJobSystem = this;
+    tlsQueueIndex = queueIndex;
+    CpuTracer::instance().setThreadName("worker " + std::to_string(queueIndex));
+
+    while (true)
+    {
+        if (tryRunOne())
+            continue;
+
+        std::unique_lock lock(sleepMutex);
+        sleepCondition.wait(lock, [&] { return stopping or queuedTasks.load(std::memory_order_acquire) > 0; });
+        if (stopping)
+            return;
+    }
+}
+
+void JobSystem::push(Task task)
+{
+    auto queueIndex = tlsJobSystem == this ? tlsQueueIndex : 0;
+    {
+        auto &queue = *queues[queueIndex];
+        std::lock_guard lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    queuedTasks.fetch_add(1, std::memory_order_release);
+
+    // taking the lock orders this with a worker that checked queuedTasks and is about to sleep
+    {
+        std::lock_guard lock(sleepMutex);
+    }
+    sleepCondition.notify_one();
+}
+
+bool JobSystem::tryRunOne()
+{
+    std::optional<Task> task;
+
+    // own work newest first, it is the most likely to still be in cache
+    auto ownIndex = tlsJobSystem == this ? tlsQueueIndex : 0;
+    {
+        auto &queue = *queues[ownIndex];
+        std::lock_guard lock(queue.mutex);
+        if (not queue.tasks.empty())
+        {
+            task.emplace(std::move(queue.tasks.back()));
+            queue.tasks.pop_back();
+        }
+    }
+
+    // steal oldest first, starting at a rotating victim so thieves spread out
+    auto queueCount = static_cast<uint32_t>(queues.size());
+    auto offset = stealOffset.fetch_add(1, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < queueCount and not task; ++i)
+    {
+        auto victimIndex = (offset + i) % queueCount;
+        if (victimIndex == ownIndex)
+            continue;
+
+        auto &queue = *queues[victimIndex];
+        std::lock_guard lock(queue.mutex);
+        if (not queue.tasks.empty())
+        {
+            task.emplace(std::move(queue.tasks.front()));
+            queue.tasks.pop_front();
+        }
+    }
+
+    if (not task)
+        return false;
+
+    queuedTasks.fetch_sub(1, std::memory_order_relaxed);
+    run(task.value());
+    return true;
+}
+
+void JobSystem::run(Task &task)
+{
+    NDEEX_TRACE_SCOPE("job");
+    if (not task.signal)
+    {
+        task.job();
+        return;
+    }
+
+    try
+    {
+        task.job();
+    }
+    catch (...)
+    {
+        std::lock_guard lock(task.signal->mutex);
+        if (not task.signal->error)
+            task.signal->error = std::current_exception();
+    }
+    finish(*task.signal);
+}
+
+void JobSystem::finish(JobCounter &counter)
+{
+    std::vector<Task> released;
+    {
+        // the lock also keeps counter alive until we are done with it, wait() takes it before returning
+        std::lock_guard lock(counter.mutex);
+        if (counter.pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        released = std::move(counter.waiters);
+    }
+    for (auto &task : released)
+    {
+        push(std::move(task));
+    }
+}
+} // namespace Core
\ No newline at end of file
@@ -0,0 +1,106 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace Core
+{
+class JobSystem;
+
+// counts unfinished jobs. jobs submitted with it as dependency start once it drops to zero,
+// the first exception thrown by one of its jobs is rethrown by JobSystem::wait
+class JobCounter
+{
+  public:
+    JobCounter() = default;
+    JobCounter(JobCounter const &) = delete;
+    JobCounter &operator=(JobCounter const &) = delete;
+
+    bool isDone() const
+    {
+        return pending.load(std::memory_order_acquire) == 0;
+    }
+
+  private:
+    friend class JobSystem;
+    struct Task
+    {
+        std::function<void()> job;
+        JobCounter *signal;
+    };
+
+    std::atomic<uint32_t> pending{0};
+    std::mutex mutex; // guards waiters and error
+    std::vector<Task> waiters;
+    std::exception_ptr error;
+};
+
+// work stealing scheduler: every worker owns a deque, pops its own work lifo and steals others' fifo.
+// threads that are not workers push into a shared queue and help executing jobs while they wait
+class JobSystem
+{
+  public:
+    using Job = std::function<void()>;
+
+    explicit JobSystem(uint32_t workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1);
+    JobSystem(JobSystem const &) = delete;
+    JobSystem &operator=(JobSystem const &) = delete;
+    ~JobSystem();
+
+    // signal is decremented once the job ran, the job is held back until dependency is done
+    void submit(Job job, JobCounter *signal = nullptr, JobCounter *dependency = nullptr);
+
+    // runs other jobs until counter is done, rethrows the first exception of its jobs
+    void wait(JobCounter &counter);
+
+    // calls function(first, last) on chunks of at most grainSize elements of [begin, end) and waits for them
+    template <typename F> void parallel_for(size_t begin, size_t end, size_t grainSize, F &&function)
+    {
+        grainSize = std::max<size_t>(grainSize, 1);
+        JobCounter counter;
+        for (size_t first = begin; first < end; first += grainSize)
+        {
+            size_t last = std::min(first + grainSize, end);
+            submit([&function, first, last] { function(first, last); }, &counter);
+        }
+        wait(counter);
+    }
+
+    uint32_t getWorkerCount() const
+    {
+        return static_cast<uint32_t>(workers.size());
+    }
+
+  private:
+    using Task = JobCounter::Task;
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(uint32_t queueIndex);
+    void push(Task task);
+    bool tryRunOne();
+    void run(Task &task);
+    void finish(JobCounter &counter);
+
+    // queue 0 is shared by external threads, queue i + 1 belongs to worker i
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::jthread> workers;
+    std::atomic<size_t> queuedTasks{0};
+    std::atomic<uint32_t> stealOffset{0};
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    bool stopping = false; // guarded by sleepMutex
+};
+} // namespace Core
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "MemoryBudget.hpp"
+#include "CpuTracer.hpp"
+#include "imgui.h"
+#include "vma/Buffer.hpp"
+#include <algorithm>
+#include <array>
+#include <format>
+#include <iterator>
+#include <print>
+
+namespace Core
+{
+namespace
+{
+constexpr double mebibyte = 1024.0 * 1024.0;
+}
+
+MemoryBudget::MemoryBudget(VmaAllocator allocator_, Metrics &metrics, bool driverBudget_, double headroom_)
+    : allocator(allocator_), driverBudget(driverBudget_), headroom(headroom_),
+      evictedBytesMetric(&metrics.counter("evicted_bytes"))
+{
+    VkPhysicalDeviceMemoryProperties const *memoryProperties;
+    vmaGetMemoryProperties(allocator, &memoryProperties);
+    heaps.resize(memoryProperties->memoryHeapCount);
+    for (uint32_t i = 0; i < heaps.size(); ++i)
+    {
+        heaps[i].deviceLocal = (memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        usageMetrics.push_back(&metrics.gauge(std::format("heap{}_usage_bytes", i)));
+        budgetMetrics.push_back(&metrics.gauge(std::format("heap{}_budget_bytes", i)));
+    }
+}
+
+void MemoryBudget::addEvictor(int priority, Evictor evictor)
+{
+    auto position = std::ranges::upper_bound(evictors, priority, {}, &EvictorEntry::priority);
+    evictors.insert(position, EvictorEntry{priority, std::move(evictor)});
+}
+
+void MemoryBudget::update(uint64_t frameNumber)
+{
+    if (!allocator)
+        return;
+    NDEEX_TRACE_FUNCTION();
+    // the budget is refreshed from the driver on frame index changes, in between vma tracks its own allocations
+    vmaSetCurrentFrameIndex(allocator, static_cast<uint32_t>(frameNumber));
+    std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets;
+    vmaGetHeapBudgets(allocator, budgets.data());
+    for (uint32_t i = 0; i < heaps.size(); ++i)
+    {
+        auto &heap = heaps[i];
+        heap.usage = budgets[i].usage;
+        heap.budget = budgets[i].budget;
+        heap.blockBytes = budgets[i].statistics.blockBytes;
+        heap.allocationBytes = budgets[i].statistics.allocationBytes;
+        usageMetrics[i]->set(static_cast<double>(heap.usage));
+        budgetMetrics[i]->set(static_cast<double>(heap.budget));
+
+        auto limit = static_cast<vk::DeviceSize>(static_cast<double>(heap.budget) * headroom);
+        if (heap.usage > limit)
+            evict(i, heap.usage - limit);
+
+        bool overBudget = heap.usage > heap.budget;
+        if (overBudget and !heap.overBudget)
+            std::println("memory heap {} over budget, {:.1f} of {:.1f} MiB", i, heap.usage / mebibyte,
+                         heap.budget / mebibyte);
+        heap.overBudget = overBudget;
+    }
+}
+
+void MemoryBudget::evict(uint32_t heapIndex, vk::DeviceSize bytesOver)
+{
+    vk::DeviceSize released = 0;
+    for (auto &entry : evictors)
+    {
+        if (released >= bytesOver)
+            break;
+        released += entry.evictor(heapIndex, bytesOver - released);
+    }
+    evictedBytesMetric->add(released);
+}
+
+void MemoryBudget::drawImGuiPanel(std::pmr::memory_resource *memory)
+{
+    ImGui::Begin("memory");
+    if (!driverBudget)
+        ImGui::TextUnformatted("no VK_EXT_memory_budget, usage and budget are estimates");
+    for (uint32_t i = 0; i < heaps.size(); ++i)
+    {
+        auto &heap = heaps[i];
+        auto fraction = heap.budget > 0 ? static_cast<float>(heap.usage) / static_cast<float>(heap.budget) : 0.0f;
+        std::pmr::string overlay(memory);
+        std::format_to(std::back_inserter(overlay), "{:.1f} / {:.1f} MiB", heap.usage / mebibyte,
+                       heap.budget / mebibyte);
+        if (heap.overBudget)
+            ImGui::PushStyleColor(ImGuiCol_PlotHistogram, ImVec4(0.9f, 0.2f, 0.2f, 1.0f));
+        ImGui::ProgressBar(std::min(fraction, 1.0f), ImVec2(-FLT_MIN, 0), overlay.c_str());
+        if (heap.overBudget)
+            ImGui::PopStyleColor();
+        ImGui::Text("heap %u%s, blocks %.1f MiB, allocations %.1f MiB", i, heap.deviceLocal ? " device local" : "",
+                    heap.blockBytes / mebibyte, heap.allocationBytes / mebibyte);
+    }
+    ImGui::SeparatorText("buffers by tag");
+    for (size_t tag = 0; tag < vma::memoryTagCount; ++tag)
+    {
+        auto memoryTag = static_cast<vma::MemoryTag>(tag);
+        ImGui::Text("%s %.1f MiB", vma::to_string(memoryTag), vma::Buffer::getTaggedBytes(memoryTag) / mebibyte);
+    }
+    ImGui::End();
+}
+} // namespace Core
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+#include "Metrics.hpp"
+#include "vma/Vma.hpp"
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
+#include <vector>
+
+namespace Core
+{
+// per heap usage against the budget the driver grants the process, polled once per frame from vma's
+// VK_EXT_memory_budget tracking, without the extension vma estimates both from its own blocks and the heap sizes.
+// before a heap runs over, the evictors get asked to let go of memory, lowest priority first, instead of silently
+// oversubscribing into paging stalls
+class MemoryBudget
+{
+  public:
+    struct Heap
+    {
+        vk::DeviceSize usage = 0;  // of the whole process, other apis and drivers included
+        vk::DeviceSize budget = 0; // what the process can use without oversubscribing
+        vk::DeviceSize blockBytes = 0;
+        vk::DeviceSize allocationBytes = 0;
+        bool deviceLocal = false;
+        bool overBudget = false; // reported once each time the heap goes over
+    };
+    // frees or downgrades resources living in heapIndex, returns the bytes on their way out. called every frame the
+    // heap stays above the headroom, so it must not count what it already released
+    using Evictor = std::function<vk::DeviceSize(uint32_t heapIndex, vk::DeviceSize bytesOver)>;
+
+    MemoryBudget() = default;
+    // driverBudget when the allocator was created with VK_EXT_memory_budget, otherwise the numbers are estimates.
+    // headroom is the share of the budget eviction keeps usage under
+    MemoryBudget(VmaAllocator allocator, Metrics &metrics, bool driverBudget, double headroom = 0.9);
+
+    // lower priorities are evicted first
+    void addEvictor(int priority, Evictor evictor);
+    void update(uint64_t frameNumber);
+    std::vector<Heap> const &getHeaps() const
+    {
+        return heaps;
+    }
+    bool isEstimated() const
+    {
+        return !driverBudget;
+    }
+    void drawImGuiPanel(std::pmr::memory_resource *memory = std::pmr::get_default_resource());
+
+  private:
+    struct EvictorEntry
+    {
+        int priority;
+        Evictor evictor;
+    };
+    void evict(uint32_t heapIndex, vk::DeviceSize bytesOver);
+
+    VmaAllocator allocator{};
+    bool driverBudget = false;
+    double headroom = 0.9;
+    std::vector<Heap> heaps;
+    std::vector<EvictorEntry> evictors; // sorted by priority
+    std::vector<Gauge *> usageMetrics;
+    std::vector<Gauge *> budgetMetrics;
+    Counter *evictedBytesMetric{};
+};
+} // namespace Core
\ No newline at end of file
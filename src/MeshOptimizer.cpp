@@ -0,0 +1,39 @@
+#include "MeshOptimizer.hpp"
+#include "CpuTracer.hpp"
+#include "helpers.hpp"
+#include <meshoptimizer.h>
+
+namespace Core::mesh::detail
+{
+std::vector<uint32_t> deduplicate(void *vertices, size_t &vertexCount, size_t vertexSize)
+{
+    NDEEX_TRACE_FUNCTION();
+    std::vector<uint32_t> remap(vertexCount);
+    auto uniqueCount =
+        meshopt_generateVertexRemap(remap.data(), nullptr, vertexCount, vertices, vertexCount, vertexSize);
+
+    std::vector<uint32_t> indices(vertexCount);
+    meshopt_remapIndexBuffer(indices.data(), nullptr, vertexCount, remap.data());
+    meshopt_remapVertexBuffer(vertices, vertices, vertexCount, vertexSize, remap.data());
+    vertexCount = uniqueCount;
+    return indices;
+}
+
+size_t optimize(void *vertices, size_t vertexCount, size_t vertexSize, std::span<uint32_t> indices,
+                std::span<IndexRange const> ranges, std::span<std::array<float, 3> const> positions,
+                float overdrawThreshold)
+{
+    NDEEX_TRACE_FUNCTION();
+    CHECKTHROW(positions.size() == vertexCount);
+    for (auto const &range : ranges)
+    {
+        CHECKTHROW(size_t{range.firstIndex} + range.indexCount <= indices.size() and range.indexCount % 3 == 0);
+        auto *rangeIndices = indices.data() + range.firstIndex;
+        meshopt_optimizeVertexCache(rangeIndices, rangeIndices, range.indexCount, vertexCount);
+        meshopt_optimizeOverdraw(rangeIndices, rangeIndices, range.indexCount, positions.data()->data(), vertexCount,
+                                 sizeof(std::array<float, 3>), overdrawThreshold);
+    }
+    // over all ranges, vertices shared between draws stay shared
+    return meshopt_optimizeVertexFetch(vertices, indices.data(), indices.size(), vertices, vertexCount, vertexSize);
+}
+} // namespace Core::mesh::detail
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+// triangle list mesh preparation on top of meshoptimizer, run once at load time
+namespace Core::mesh
+{
+// indices of one draw, optimized independently of the others
+struct IndexRange
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+};
+
+namespace detail
+{
+std::vector<uint32_t> deduplicate(void *vertices, size_t &vertexCount, size_t vertexSize);
+size_t optimize(void *vertices, size_t vertexCount, size_t vertexSize, std::span<uint32_t> indices,
+                std::span<IndexRange const> ranges, std::span<std::array<float, 3> const> positions,
+                float overdrawThreshold);
+} // namespace detail
+
+// indexes a non indexed triangle list: bitwise identical vertices are merged, vertices keeps the unique ones
+template <typename V> std::vector<uint32_t> deduplicate(std::vector<V> &vertices)
+{
+    static_assert(std::is_trivially_copyable_v<V>);
+    size_t vertexCount = vertices.size();
+    auto indices = detail::deduplicate(vertices.data(), vertexCount, sizeof(V));
+    vertices.resize(vertexCount);
+    return indices;
+}
+
+// reorders the triangles of every range for the post transform cache and then for less overdraw, as long as that
+// costs at most overdrawThreshold times the cache misses. then reorders the vertices in order of first use for fetch
+// locality, dropping unreferenced ones. position returns the xyz of a vertex
+template <typename V, typename PositionFunction>
+void optimize(std::vector<V> &vertices, std::vector<uint32_t> &indices, std::span<IndexRange const> ranges,
+              PositionFunction position, float overdrawThreshold = 1.05f)
+{
+    static_assert(std::is_trivially_copyable_v<V>);
+    std::vector<std::array<float, 3>> positions;
+    positions.reserve(vertices.size());
+    for (auto const &vertex : vertices)
+        positions.push_back(position(vertex));
+    vertices.resize(detail::optimize(vertices.data(), vertices.size(), sizeof(V), indices, ranges, positions,
+                                     overdrawThreshold));
+}
+} // namespace Core::mesh
\ No newline at end of file
@@ -0,0 +1,228 @@
+#include "Metrics.hpp"
+#include "imgui.h"
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <iterator>
+#include <print>
+#include <utility>
+
+namespace Core
+{
+namespace
+{
+uint64_t percentileRank(double p, uint64_t count)
+{
+    return std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p / 100.0 * static_cast<double>(count))));
+}
+} // namespace
+
+void Histogram::record(double value)
+{
+    auto units = static_cast<uint64_t>(std::max(value, 0.0) / resolution);
+    buckets[bucketIndex(units)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+    last.store(value, std::memory_order_relaxed);
+    auto currentMax = max.load(std::memory_order_relaxed);
+    while (value > currentMax and !max.compare_exchange_weak(currentMax, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+// the fields are read one by one, concurrent records may make count and buckets disagree slightly
+Histogram::Snapshot Histogram::snapshot() const
+{
+    Snapshot snapshot{.buckets = std::vector<uint64_t>(bucketCount),
+                      .count = 0,
+                      .sum = sum.load(std::memory_order_relaxed),
+                      .resolution = resolution};
+    for (uint32_t i = 0; i < bucketCount; ++i)
+    {
+        snapshot.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.buckets[i];
+    }
+    return snapshot;
+}
+
+// count is read before the buckets, ranks that concurrent records pushed past them take the last bucket seen
+void Histogram::percentiles(std::span<double const> ps, std::span<double> values) const
+{
+    std::ranges::fill(values, 0.0);
+    auto total = getCount();
+    if (total == 0)
+        return;
+    size_t next = 0;
+    uint64_t seen = 0;
+    double middle = 0.0;
+    for (uint32_t i = 0; i < bucketCount and next < ps.size(); ++i)
+    {
+        auto inBucket = buckets[i].load(std::memory_order_relaxed);
+        if (inBucket == 0)
+            continue;
+        seen += inBucket;
+        auto [lower, width] = bucketRange(i);
+        middle = (static_cast<double>(lower) + static_cast<double>(width) / 2.0) * resolution;
+        while (next < ps.size() and seen >= percentileRank(ps[next], total))
+            values[next++] = middle;
+    }
+    for (; next < ps.size(); ++next)
+        values[next] = middle;
+}
+
+double Histogram::Snapshot::percentile(double p) const
+{
+    if (count == 0)
+        return 0.0;
+    auto rank = percentileRank(p, count);
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < buckets.size(); ++i)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+        {
+            auto [lower, width] = bucketRange(i);
+            return (static_cast<double>(lower) + static_cast<double>(width) / 2.0) * resolution;
+        }
+    }
+    return 0.0;
+}
+
+Histogram::Snapshot Histogram::Snapshot::operator-(Snapshot const &older) const
+{
+    Snapshot difference = *this;
+    if (older.buckets.size() != buckets.size())
+        return difference;
+    difference.count = 0;
+    for (size_t i = 0; i < buckets.size(); ++i)
+    {
+        difference.buckets[i] -= older.buckets[i];
+        difference.count += difference.buckets[i];
+    }
+    difference.sum -= older.sum;
+    return difference;
+}
+
+Counter &Metrics::counter(std::string_view name)
+{
+    std::lock_guard lock(mutex);
+    auto it = counters.find(name);
+    if (it == counters.end())
+        it = counters.emplace(std::string(name), std::make_unique<Counter>()).first;
+    return *it->second;
+}
+
+Gauge &Metrics::gauge(std::string_view name)
+{
+    std::lock_guard lock(mutex);
+    auto it = gauges.find(name);
+    if (it == gauges.end())
+        it = gauges.emplace(std::string(name), GaugeEntry{std::make_unique<Gauge>(), {}}).first;
+    return *it->second.gauge;
+}
+
+Histogram &Metrics::histogram(std::string_view name, double resolution)
+{
+    std::lock_guard lock(mutex);
+    auto it = histograms.find(name);
+    if (it == histograms.end())
+        it = histograms.emplace(std::string(name), HistogramEntry{std::make_unique<Histogram>(resolution), {}, {}})
+                 .first;
+    return *it->second.histogram;
+}
+
+void Metrics::startDump(std::filesystem::path const &path, std::chrono::milliseconds interval)
+{
+    std::lock_guard lock(mutex);
+    dumpFile.open(path, std::ios::app);
+    if (!dumpFile)
+        std::println("could not open {} for the metrics dump", path.string());
+    dumpInterval = interval;
+    lastDumpTime = std::chrono::steady_clock::now();
+    for (auto &[name, entry] : histograms)
+        entry.lastDump = entry.histogram->snapshot();
+}
+
+void Metrics::Graph::push(double value)
+{
+    values.push_back(static_cast<float>(value));
+    if (values.size() > graphLength)
+        values.pop_front();
+}
+
+void Metrics::update()
+{
+    {
+        std::lock_guard lock(mutex);
+        for (auto &[name, entry] : gauges)
+            entry.graph.push(entry.gauge->get());
+        for (auto &[name, entry] : histograms)
+            entry.graph.push(entry.histogram->getLast());
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (dumpFile.is_open() and now - lastDumpTime >= dumpInterval)
+    {
+        lastDumpTime = now;
+        dump();
+    }
+}
+
+void Metrics::dump()
+{
+    std::lock_guard lock(mutex);
+    std::string line = std::format(
+        "{{\"time_s\":{:.3f}", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+    line += ",\"counters\":{";
+    for (bool first = true; auto &[name, counter] : counters)
+        line += std::format("{}\"{}\":{}", std::exchange(first, false) ? "" : ",", name, counter->get());
+    line += "},\"gauges\":{";
+    for (bool first = true; auto &[name, entry] : gauges)
+        line += std::format("{}\"{}\":{}", std::exchange(first, false) ? "" : ",", name, entry.gauge->get());
+    // percentiles of the interval since the previous line, not of the whole run
+    line += "},\"histograms\":{";
+    for (bool first = true; auto &[name, entry] : histograms)
+    {
+        auto current = entry.histogram->snapshot();
+        auto interval = current - entry.lastDump;
+        entry.lastDump = std::move(current);
+        line += std::format("{}\"{}\":{{\"count\":{},\"mean\":{},\"p50\":{},\"p90\":{},\"p99\":{},\"p999\":{}}}",
+                            std::exchange(first, false) ? "" : ",", name, interval.count, interval.mean(),
+                            interval.percentile(50), interval.percentile(90), interval.percentile(99),
+                            interval.percentile(99.9));
+    }
+    line += "}}\n";
+    dumpFile << line;
+    dumpFile.flush();
+}
+
+void Metrics::drawImGuiPanel(std::pmr::memory_resource *memory)
+{
+    std::lock_guard lock(mutex);
+    ImGui::Begin("metrics");
+    for (auto &[name, counter] : counters)
+        ImGui::Text("%s %llu", name.c_str(), static_cast<unsigned long long>(counter->get()));
+    for (auto &[name, entry] : gauges)
+    {
+        std::pmr::vector<float> values(entry.graph.values.begin(), entry.graph.values.end(), memory);
+        std::pmr::string overlay(memory);
+        std::format_to(std::back_inserter(overlay), "{}", entry.gauge->get());
+        ImGui::PlotLines(name.c_str(), values.data(), static_cast<int>(values.size()), 0, overlay.c_str());
+    }
+    for (auto &[name, entry] : histograms)
+    {
+        // percentiles over the whole run, the graph shows the latest values
+        constexpr std::array ps{50.0, 99.0, 99.9};
+        std::array<double, ps.size()> percentiles;
+        entry.histogram->percentiles(ps, percentiles);
+        std::pmr::vector<float> values(entry.graph.values.begin(), entry.graph.values.end(), memory);
+        std::pmr::string overlay(memory);
+        std::format_to(std::back_inserter(overlay), "p50 {:.3f} p99 {:.3f} p99.9 {:.3f} max {:.3f}", percentiles[0],
+                       percentiles[1], percentiles[2], entry.histogram->getMax());
+        ImGui::PlotLines(name.c_str(), values.data(), static_cast<int>(values.size()), 0, overlay.c_str(), 0.0f,
+                         FLT_MAX, ImVec2(0, 60));
+    }
+    ImGui::End();
+}
+} // namespace Core
\ No newline at end of file
@@ -0,0 +1,179 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Core
+{
+// monotonically increasing count, safe to add to from any thread
+class Counter
+{
+  public:
+    void add(uint64_t amount = 1)
+    {
+        value.fetch_add(amount, std::memory_order_relaxed);
+    }
+    uint64_t get() const
+    {
+        return value.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic<uint64_t> value{0};
+};
+
+// last set value, safe to set from any thread
+class Gauge
+{
+  public:
+    void set(double newValue)
+    {
+        value.store(newValue, std::memory_order_relaxed);
+    }
+    double get() const
+    {
+        return value.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic<double> value{0.0};
+};
+
+// hdr style histogram: values are counted in units of resolution, exact below 16 units and in 16 linear sub buckets
+// per power of two above, so every percentile is within ~6% of the true value. recording is lock free and never
+// allocates, from any thread
+class Histogram
+{
+  public:
+    static constexpr uint32_t subBucketBits = 4;
+    static constexpr uint32_t subBucketCount = 1 << subBucketBits;
+    static constexpr uint32_t bucketCount = (64 - subBucketBits + 1) * subBucketCount;
+
+    // bucket counts at one point in time, subtracting an older snapshot gives the interval in between
+    struct Snapshot
+    {
+        std::vector<uint64_t> buckets;
+        uint64_t count = 0;
+        double sum = 0.0;
+        double resolution = 1.0;
+
+        // p in [0, 100], the middle of the bucket holding that rank, 0 when empty
+        double percentile(double p) const;
+        double mean() const
+        {
+            return count ? sum / static_cast<double>(count) : 0.0;
+        }
+        Snapshot operator-(Snapshot const &older) const;
+    };
+
+    explicit Histogram(double resolution_ = 1.0) : resolution(resolution_)
+    {
+    }
+
+    void record(double value);
+
+    uint64_t getCount() const
+    {
+        return count.load(std::memory_order_relaxed);
+    }
+    double getMax() const
+    {
+        return max.load(std::memory_order_relaxed);
+    }
+    double getLast() const
+    {
+        return last.load(std::memory_order_relaxed);
+    }
+    Snapshot snapshot() const;
+    // percentiles over the whole run read from the live buckets in one pass, without copying them into a snapshot.
+    // ps ascending in [0, 100], values the same size
+    void percentiles(std::span<double const> ps, std::span<double> values) const;
+
+    static uint32_t bucketIndex(uint64_t units)
+    {
+        if (units < subBucketCount)
+            return static_cast<uint32_t>(units);
+        uint32_t exponent = std::bit_width(units) - 1;
+        uint32_t shift = exponent - subBucketBits;
+        return (shift + 1) * subBucketCount + static_cast<uint32_t>((units >> shift) & (subBucketCount - 1));
+    }
+    // [lower, lower + width) in units
+    static std::pair<uint64_t, uint64_t> bucketRange(uint32_t index)
+    {
+        if (index < subBucketCount)
+            return {index, 1};
+        uint32_t shift = index / subBucketCount - 1;
+        uint64_t lower = static_cast<uint64_t>(subBucketCount + index % subBucketCount) << shift;
+        return {lower, 1ull << shift};
+    }
+
+  private:
+    double resolution;
+    std::array<std::atomic<uint64_t>, bucketCount> buckets{};
+    std::atomic<uint64_t> count{0};
+    std::atomic<double> sum{0.0};
+    std::atomic<double> max{0.0};
+    std::atomic<double> last{0.0};
+};
+
+// named metrics of the engine. metrics are created on first lookup and stay at the same address, so hot paths look
+// them up once and keep the reference. update() once per frame feeds the graphs and the periodic json lines dump
+class Metrics
+{
+  public:
+    Counter &counter(std::string_view name);
+    Gauge &gauge(std::string_view name);
+    // resolution is the smallest difference the histogram tells apart, in the unit values are recorded in
+    Histogram &histogram(std::string_view name, double resolution = 1.0);
+
+    // every interval one json object per line with the counters, gauges and the percentiles of the interval
+    void startDump(std::filesystem::path const &path, std::chrono::milliseconds interval = std::chrono::seconds{1});
+    void update();
+    // scratch strings and graphs of the panel come from memory, e.g. the frame arena
+    void drawImGuiPanel(std::pmr::memory_resource *memory = std::pmr::get_default_resource());
+
+  private:
+    static constexpr size_t graphLength = 240;
+    struct Graph
+    {
+        std::deque<float> values;
+        void push(double value);
+    };
+    struct HistogramEntry
+    {
+        std::unique_ptr<Histogram> histogram;
+        Histogram::Snapshot lastDump;
+        Graph graph;
+    };
+    struct GaugeEntry
+    {
+        std::unique_ptr<Gauge> gauge;
+        Graph graph;
+    };
+
+    void dump();
+
+    std::mutex mutex; // guards the maps, not the metrics
+    std::map<std::string, std::unique_ptr<Counter>, std::less<>> counters;
+    std::map<std::string, GaugeEntry, std::less<>> gauges;
+    std::map<std::string, HistogramEntry, std::less<>> histograms;
+
+    std::ofstream dumpFile;
+    std::chrono::milliseconds dumpInterval{};
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point lastDumpTime;
+};
+} // namespace Core
\ No newline at end of file
@@ -0,0 +1,129 @@
+#pragma once
+#include "Exception.hpp"
+#include "RenderTarget.hpp"
+#include "Vulkan.hpp"
+#include "vma/Image.hpp"
+#include <print>
+#include <vector>
+
+// swapchain stand-in for headless rendering, owns vma allocated images to render into
+class Offscreen
+{
+  public:
+    Offscreen() = default;
+    Offscreen(vk::Device device_, VmaAllocator allocator_, vk::Format format_)
+        : device(device_), allocator(allocator_), format(format_)
+    {
+    }
+    Offscreen(Offscreen const &) = delete;
+    Offscreen &operator=(Offscreen const &) = delete;
+    Offscreen(Offscreen &&other) = default;
+    Offscreen &operator=(Offscreen &&other)
+    {
+        cleanupRenderTargets();
+
+        device = other.device;
+        allocator = other.allocator;
+        format = other.format;
+        images = std::move(other.images);
+        renderTargets = std::move(other.renderTargets);
+        return *this;
+    }
+
+    ~Offscreen()
+    {
+        cleanupRenderTargets();
+    }
+
+    // what a recreate replaced, frames still in flight may use it so it must outlive them
+    struct Retired
+    {
+        std::vector<vma::Image> images;
+        std::vector<RenderTarget> renderTargets; // declared last so the views go before the images
+    };
+
+    [[nodiscard]] Retired recreate(vk::Extent2D newExtent, uint32_t imageCount)
+    {
+        Retired retired{std::move(images), std::move(renderTargets)};
+        images.clear();
+        renderTargets.clear();
+
+        VkImageCreateInfo imageCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = static_cast<VkFormat>(format),
+            .extent = {newExtent.width, newExtent.height, 1},
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, // transfer src for readback
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        };
+        VmaAllocationCreateInfo allocationCreateInfo{
+            .flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT, // render targets are big, keep them out of the blocks
+            .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+        };
+
+        renderTargets.resize(imageCount);
+        for (uint32_t i = 0; i < imageCount; i++)
+        {
+            auto &image = images.emplace_back(allocator, imageCreateInfo, allocationCreateInfo);
+
+            vk::ImageViewCreateInfo imageViewCreateInfo{
+                .image = image.getImageHandle(),
+                .viewType = vk::ImageViewType::e2D,
+                .format = format,
+                .components = {vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eG, vk::ComponentSwizzle::eB,
+                               vk::ComponentSwizzle::eA},
+                .subresourceRange = {.aspectMask = vk::ImageAspectFlagBits::eColor,
+                                     .baseMipLevel = 0,
+                                     .levelCount = 1,
+                                     .baseArrayLayer = 0,
+                                     .layerCount = 1},
+            };
+
+            renderTargets[i].imageIndex = i;
+            renderTargets[i].imageHandle = image.getImageHandle();
+            renderTargets[i].imageView = device.createImageViewUnique(imageViewCreateInfo);
+        }
+
+        std::println("offscreen re/created with {} images of {}x{}", renderTargets.size(), newExtent.width,
+                     newExtent.height);
+        return retired;
+    }
+
+    RenderTarget &getRenderTarget(uint32_t renderTargetIndex)
+    {
+        if (renderTargetIndex >= renderTargets.size())
+        {
+            throw Core::runtime_error("Invalid render target index: {}", renderTargetIndex);
+        }
+        return renderTargets[renderTargetIndex];
+    }
+
+    vk::Format getFormat() const
+    {
+        return format;
+    }
+
+    std::size_t size()
+    {
+        return renderTargets.size();
+    }
+
+  private:
+    void cleanupRenderTargets()
+    {
+        // views first, they reference the images
+        renderTargets.clear();
+        images.clear();
+    }
+
+    vk::Device device;
+    VmaAllocator allocator{};
+    vk::Format format;
+    std::vector<vma::Image> images;
+    std::vector<RenderTarget> renderTargets;
+};
\ No newline at end of file
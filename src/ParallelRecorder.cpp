@@ -0,0 +1,71 @@
+#include "ParallelRecorder.hpp"
+#include "CpuTracer.hpp"
+#include <algorithm>
+
+ParallelRecorder::ParallelRecorder(vk::Device device_, uint32_t queueFamilyIndex, uint32_t chunkCount_,
+                                   uint32_t framesInFlight)
+    : device(device_), chunkCount(std::max(chunkCount_, 1u))
+{
+    for (uint32_t i = 0; i < framesInFlight * chunkCount; ++i)
+    {
+        auto commandPool = device.createCommandPoolUnique(vk::CommandPoolCreateInfo{
+            .flags = vk::CommandPoolCreateFlagBits::eTransient, .queueFamilyIndex = queueFamilyIndex});
+        auto commandBuffers = device.allocateCommandBuffersUnique(
+            vk::CommandBufferAllocateInfo{.commandPool = commandPool.get(),
+                                          .level = vk::CommandBufferLevel::eSecondary,
+                                          .commandBufferCount = 1});
+        contexts.push_back(ChunkContext{std::move(commandPool), std::move(commandBuffers.front())});
+    }
+}
+
+void ParallelRecorder::record(Core::JobSystem &jobSystem, Core::JobCounter &done, Core::JobCounter *dependency,
+                              uint32_t frameIndex, vk::Format colorFormat_, size_t itemCount,
+                              RecordFunction recordChunk_)
+{
+    secondaries.clear();
+    if (itemCount == 0)
+        return;
+
+    recordChunk = std::move(recordChunk_);
+    colorFormat = colorFormat_;
+
+    // no empty chunks
+    size_t chunkSize = (itemCount + chunkCount - 1) / chunkCount;
+    auto usedChunkCount = static_cast<uint32_t>((itemCount + chunkSize - 1) / chunkSize);
+    secondaries.resize(usedChunkCount);
+
+    for (uint32_t chunk = 0; chunk < usedChunkCount; ++chunk)
+    {
+        jobSystem.submit(
+            [this, frameIndex, chunk, chunkSize, itemCount] {
+                NDEEX_TRACE_SCOPE("record chunk");
+                vk::CommandBufferInheritanceRenderingInfo renderingInheritance{
+                    .colorAttachmentCount = 1,
+                    .pColorAttachmentFormats = &colorFormat,
+                    .rasterizationSamples = vk::SampleCountFlagBits::e1,
+                };
+                vk::CommandBufferInheritanceInfo inheritance{.pNext = &renderingInheritance};
+
+                auto &context = getContext(frameIndex, chunk);
+                // the frame's previous submission is complete, nothing references this pool anymore
+                device.resetCommandPool(context.commandPool.get());
+
+                vk::CommandBuffer cmd = context.commandBuffer.get();
+                cmd.begin(vk::CommandBufferBeginInfo{.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit |
+                                                              vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+                                                     .pInheritanceInfo = &inheritance});
+                size_t first = chunk * chunkSize;
+                recordChunk(cmd, first, std::min(chunkSize, itemCount - first));
+                cmd.end();
+                secondaries[chunk] = cmd;
+            },
+            &done, dependency);
+    }
+}
+
+void ParallelRecorder::execute(vk::CommandBuffer primary)
+{
+    // executed in chunk order so the draw order matches single threaded recording
+    if (not secondaries.empty())
+        primary.executeCommands(secondaries);
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+#include "JobSystem.hpp"
+#include "Vulkan.hpp"
+#include <functional>
+#include <vector>
+
+// records draws into secondary command buffers as jobs and executes them from the primary.
+// every chunk owns a command pool per frame in flight and is recorded by one job, so pools are reset without locking
+class ParallelRecorder
+{
+  public:
+    // records items [first, first + count) into a secondary that continues the primary's dynamic rendering
+    using RecordFunction = std::function<void(vk::CommandBuffer cmd, size_t first, size_t count)>;
+
+    ParallelRecorder() = default;
+    ParallelRecorder(vk::Device device, uint32_t queueFamilyIndex, uint32_t chunkCount, uint32_t framesInFlight);
+
+    // submits one recording job per chunk signaling done, they start once dependency (if any) is done
+    void record(Core::JobSystem &jobSystem, Core::JobCounter &done, Core::JobCounter *dependency, uint32_t frameIndex,
+                vk::Format colorFormat, size_t itemCount, RecordFunction recordChunk);
+
+    // after done: primary must be inside beginRendering with eContentsSecondaryCommandBuffers
+    void execute(vk::CommandBuffer primary);
+
+    uint32_t getChunkCount() const
+    {
+        return chunkCount;
+    }
+
+  private:
+    struct ChunkContext
+    {
+        vk::UniqueCommandPool commandPool;
+        vk::UniqueCommandBuffer commandBuffer; // declared after the pool so it is freed first
+    };
+
+    ChunkContext &getContext(uint32_t frameIndex, uint32_t chunk)
+    {
+        return contexts.at(frameIndex * chunkCount + chunk);
+    }
+
+    vk::Device device;
+    uint32_t chunkCount = 0;
+    std::vector<ChunkContext> contexts; // [frameIndex * chunkCount + chunk]
+
+    // state of the recording in progress, read by its jobs
+    RecordFunction recordChunk;
+    vk::Format colorFormat{};
+    std::vector<vk::CommandBuffer> secondaries;
+};
\ No newline at end of file
@@ -0,0 +1,238 @@
+#include "RenderGraph.hpp"
+#include <algorithm>
+#include <memory_resource>
+#include <unordered_set>
+
+namespace
+{
+constexpr vk::AccessFlags2 writeAccessMask =
+    vk::AccessFlagBits2::eShaderWrite | vk::AccessFlagBits2::eColorAttachmentWrite |
+    vk::AccessFlagBits2::eDepthStencilAttachmentWrite | vk::AccessFlagBits2::eTransferWrite |
+    vk::AccessFlagBits2::eHostWrite | vk::AccessFlagBits2::eMemoryWrite | vk::AccessFlagBits2::eShaderStorageWrite;
+
+bool contains(vk::PipelineStageFlags2 stages, vk::PipelineStageFlags2 other)
+{
+    return (stages & other) == other;
+}
+bool contains(vk::AccessFlags2 access, vk::AccessFlags2 other)
+{
+    return (access & other) == other;
+}
+} // namespace
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::read(ResourceHandle resource, Access access)
+{
+    graph.passes[passIndex].uses.push_back(ResourceUse{resource, access, true, false});
+    return *this;
+}
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::write(ResourceHandle resource, Access access)
+{
+    graph.passes[passIndex].uses.push_back(ResourceUse{resource, access, false, true});
+    return *this;
+}
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::readWrite(ResourceHandle resource, Access access)
+{
+    graph.passes[passIndex].uses.push_back(ResourceUse{resource, access, true, true});
+    return *this;
+}
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::sideEffects()
+{
+    graph.passes[passIndex].sideEffects = true;
+    return *this;
+}
+void RenderGraph::PassBuilder::execute(ExecuteFunction function)
+{
+    graph.passes[passIndex].execute = std::move(function);
+}
+
+RenderGraph::ResourceHandle RenderGraph::importImage(std::string_view name, vk::Image image,
+                                                     vk::ImageSubresourceRange range, Access initial)
+{
+    resources.push_back(
+        Resource{.name = std::pmr::string(name, memory), .image = image, .range = range, .initial = initial});
+    return static_cast<ResourceHandle>(resources.size() - 1);
+}
+RenderGraph::ResourceHandle RenderGraph::importBuffer(std::string_view name, Access initial)
+{
+    resources.push_back(Resource{.name = std::pmr::string(name, memory), .initial = initial});
+    return static_cast<ResourceHandle>(resources.size() - 1);
+}
+void RenderGraph::setFinalAccess(ResourceHandle resource, Access access)
+{
+    resources[resource].final = access;
+}
+
+RenderGraph::PassBuilder RenderGraph::addPass(std::string_view name)
+{
+    passes.push_back(Pass{.name = std::pmr::string(name, memory),
+                          .uses = std::pmr::vector<ResourceUse>(memory),
+                          .barriers = Barriers{.imageBarriers = std::pmr::vector<vk::ImageMemoryBarrier2>(memory)}});
+    return PassBuilder(*this, passes.size() - 1);
+}
+
+void RenderGraph::compile()
+{
+    cull();
+
+    for (auto &resource : resources)
+    {
+        auto const &initial = resource.initial;
+        bool writes = bool(initial.access & writeAccessMask);
+        resource.state = ResourceState{.writeStages = writes ? initial.stages : vk::PipelineStageFlags2{},
+                                       .writeAccess = initial.access & writeAccessMask,
+                                       .readStages = writes ? vk::PipelineStageFlags2{} : initial.stages,
+                                       .visibleStages = {},
+                                       .visibleAccess = {},
+                                       .layout = initial.layout};
+    }
+    for (auto &pass : passes)
+    {
+        pass.barriers.memoryBarrier = vk::MemoryBarrier2{};
+        pass.barriers.imageBarriers.clear();
+        if (pass.culled)
+            continue;
+        for (auto const &use : pass.uses)
+            addBarrier(pass.barriers, resources[use.resource], use.access);
+    }
+    finalBarriers.emplace(Barriers{.imageBarriers = std::pmr::vector<vk::ImageMemoryBarrier2>(memory)});
+    for (auto &resource : resources)
+    {
+        if (resource.final)
+            addBarrier(finalBarriers.value(), resource, resource.final.value());
+    }
+}
+
+void RenderGraph::execute(vk::CommandBuffer cmd, GpuProfiler *profiler)
+{
+    for (auto const &pass : passes)
+    {
+        if (pass.culled)
+            continue;
+        // the zone includes the pass's barriers, waiting for its inputs is part of its cost
+        std::optional<GpuProfiler::Scope> zone;
+        if (profiler)
+            zone.emplace(*profiler, cmd, pass.name);
+        pass.barriers.record(cmd);
+        if (pass.execute)
+            pass.execute(cmd);
+    }
+    if (finalBarriers)
+        finalBarriers->record(cmd);
+}
+
+void RenderGraph::reset(std::pmr::memory_resource *memory_)
+{
+    resources.clear();
+    passes.clear();
+    finalBarriers.reset();
+    memory = memory_;
+}
+
+// walks the passes backwards from the outputs, a pass is kept when a kept pass or an output needs what it writes
+void RenderGraph::cull()
+{
+    std::pmr::unordered_set<ResourceHandle> needed(memory);
+    for (ResourceHandle i = 0; i < resources.size(); ++i)
+    {
+        if (resources[i].final)
+            needed.insert(i);
+    }
+    for (auto pass = passes.rbegin(); pass != passes.rend(); ++pass)
+    {
+        pass->culled = !pass->sideEffects && std::ranges::none_of(pass->uses, [&](ResourceUse const &use) {
+            return use.writes and needed.contains(use.resource);
+        });
+        if (pass->culled)
+            continue;
+        // a plain write replaces the contents so earlier writers are not needed for it anymore
+        for (auto const &use : pass->uses)
+        {
+            if (use.writes and !use.reads)
+                needed.erase(use.resource);
+        }
+        for (auto const &use : pass->uses)
+        {
+            if (use.reads)
+                needed.insert(use.resource);
+        }
+    }
+}
+
+void RenderGraph::addBarrier(Barriers &barriers, Resource &resource, Access access)
+{
+    auto &state = resource.state;
+    bool isImage = bool(resource.image);
+    bool layoutChange = isImage and access.layout != state.layout;
+    vk::AccessFlags2 writeAccess = access.access & writeAccessMask;
+
+    vk::PipelineStageFlags2 srcStages;
+    vk::AccessFlags2 srcAccess;
+    bool needed = false;
+    if (writeAccess or layoutChange)
+    {
+        // write after write and write after read, a layout transition counts as a write
+        srcStages = state.writeStages | state.readStages;
+        srcAccess = state.writeAccess;
+        needed = layoutChange or bool(srcStages);
+
+        state.writeStages = access.stages;
+        state.writeAccess = writeAccess;
+        state.readStages = (access.access & ~writeAccessMask) ? access.stages : vk::PipelineStageFlags2{};
+        state.visibleStages = access.stages;
+        state.visibleAccess = access.access;
+    }
+    else
+    {
+        // read after write, skipped when an earlier barrier already made the write visible here
+        srcStages = state.writeStages;
+        srcAccess = state.writeAccess;
+        needed = bool(srcStages) and
+                 !(contains(state.visibleStages, access.stages) and contains(state.visibleAccess, access.access));
+
+        if (needed)
+        {
+            state.visibleStages |= access.stages;
+            state.visibleAccess |= access.access;
+        }
+        state.readStages |= access.stages;
+    }
+    if (!needed)
+        return;
+
+    if (isImage)
+    {
+        barriers.imageBarriers.push_back(vk::ImageMemoryBarrier2{.srcStageMask = srcStages,
+                                                                 .srcAccessMask = srcAccess,
+                                                                 .dstStageMask = access.stages,
+                                                                 .dstAccessMask = access.access,
+                                                                 .oldLayout = state.layout,
+                                                                 .newLayout = layoutChange ? access.layout
+                                                                                           : state.layout,
+                                                                 .srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+                                                                 .dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+                                                                 .image = resource.image,
+                                                                 .subresourceRange = resource.range});
+        state.layout = barriers.imageBarriers.back().newLayout;
+    }
+    else
+    {
+        // all buffer hazards of a pass merge into one global memory barrier
+        barriers.memoryBarrier.srcStageMask |= srcStages;
+        barriers.memoryBarrier.srcAccessMask |= srcAccess;
+        barriers.memoryBarrier.dstStageMask |= access.stages;
+        barriers.memoryBarrier.dstAccessMask |= access.access;
+    }
+}
+
+void RenderGraph::Barriers::record(vk::CommandBuffer cmd) const
+{
+    bool hasMemoryBarrier = bool(memoryBarrier.srcStageMask | memoryBarrier.dstStageMask);
+    if (!hasMemoryBarrier and imageBarriers.empty())
+        return;
+    cmd.pipelineBarrier2(vk::DependencyInfo{
+        .memoryBarrierCount = hasMemoryBarrier ? 1u : 0u,
+        .pMemoryBarriers = &memoryBarrier,
+        .imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size()),
+        .pImageMemoryBarriers = imageBarriers.data(),
+    });
+}
\ No newline at end of file
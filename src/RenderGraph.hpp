@@ -0,0 +1,136 @@
+#pragma once
+#include "GpuProfiler.hpp"
+#include "Vulkan.hpp"
+#include <functional>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// per frame graph of passes that declare how they use images and buffers.
+// compile() culls passes nothing depends on and derives one batched pipelineBarrier2 per pass from the declared
+// accesses, so no pass has to hand code its transitions
+class RenderGraph
+{
+  public:
+    using ResourceHandle = uint32_t;
+    using ExecuteFunction = std::function<void(vk::CommandBuffer cmd)>;
+
+    // how a resource is touched, layout is ignored for buffers
+    struct Access
+    {
+        vk::PipelineStageFlags2 stages;
+        vk::AccessFlags2 access;
+        vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+    };
+    static constexpr Access ColorAttachmentWrite{vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+                                                 vk::AccessFlagBits2::eColorAttachmentWrite,
+                                                 vk::ImageLayout::eColorAttachmentOptimal};
+    // loadOp load on top of previous contents
+    static constexpr Access ColorAttachmentReadWrite{
+        vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+        vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite,
+        vk::ImageLayout::eColorAttachmentOptimal};
+    static constexpr Access TransferWrite{vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite,
+                                          vk::ImageLayout::eTransferDstOptimal};
+    static constexpr Access TransferRead{vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferRead,
+                                         vk::ImageLayout::eTransferSrcOptimal};
+    static constexpr Access VertexAttributeRead{vk::PipelineStageFlagBits2::eVertexAttributeInput,
+                                                vk::AccessFlagBits2::eVertexAttributeRead};
+    // vertex pulling through buffer device addresses
+    static constexpr Access VertexShaderStorageRead{vk::PipelineStageFlagBits2::eVertexShader,
+                                                    vk::AccessFlagBits2::eShaderStorageRead};
+    static constexpr Access IndexRead{vk::PipelineStageFlagBits2::eIndexInput, vk::AccessFlagBits2::eIndexRead};
+    static constexpr Access Present{vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone,
+                                    vk::ImageLayout::ePresentSrcKHR};
+
+    class PassBuilder
+    {
+      public:
+        PassBuilder &read(ResourceHandle resource, Access access);
+        PassBuilder &write(ResourceHandle resource, Access access);
+        PassBuilder &readWrite(ResourceHandle resource, Access access);
+        // never culled, e.g. writes something outside the graph
+        PassBuilder &sideEffects();
+        void execute(ExecuteFunction function);
+
+      private:
+        friend class RenderGraph;
+        PassBuilder(RenderGraph &graph_, size_t passIndex_) : graph(graph_), passIndex(passIndex_)
+        {
+        }
+        RenderGraph &graph;
+        size_t passIndex;
+    };
+
+    // initial describes the last use before the graph, e.g. the acquire semaphore's wait stage for swapchain images
+    ResourceHandle importImage(std::string_view name, vk::Image image, vk::ImageSubresourceRange range,
+                               Access initial = {});
+    // buffers are synchronized with global memory barriers, so only their name is kept
+    ResourceHandle importBuffer(std::string_view name, Access initial = {});
+    // state the resource has to be left in, resources with a final access are the outputs of the graph
+    void setFinalAccess(ResourceHandle resource, Access access);
+
+    PassBuilder addPass(std::string_view name);
+
+    void compile();
+    // with a profiler every pass gets a gpu zone
+    void execute(vk::CommandBuffer cmd, GpuProfiler *profiler = nullptr);
+    // drops all passes and resources, called at the start of every frame. names, uses and barriers of the new frame
+    // are allocated from memory, which has to outlive them, e.g. the frame arena
+    void reset(std::pmr::memory_resource *memory = std::pmr::get_default_resource());
+
+  private:
+    struct ResourceUse
+    {
+        ResourceHandle resource;
+        Access access;
+        bool reads;
+        bool writes;
+    };
+    struct Barriers
+    {
+        vk::MemoryBarrier2 memoryBarrier{};
+        std::pmr::vector<vk::ImageMemoryBarrier2> imageBarriers;
+
+        void record(vk::CommandBuffer cmd) const;
+    };
+    struct Pass
+    {
+        std::pmr::string name;
+        std::pmr::vector<ResourceUse> uses;
+        ExecuteFunction execute;
+        bool sideEffects = false;
+        bool culled = false;
+        Barriers barriers; // recorded before execute
+    };
+    // synchronization state of a resource while walking the passes
+    struct ResourceState
+    {
+        vk::PipelineStageFlags2 writeStages;
+        vk::AccessFlags2 writeAccess;
+        vk::PipelineStageFlags2 readStages; // reads since the last write, a write has to wait for them
+        vk::PipelineStageFlags2 visibleStages; // where the last write was already made visible
+        vk::AccessFlags2 visibleAccess;
+        vk::ImageLayout layout;
+    };
+    struct Resource
+    {
+        std::pmr::string name;
+        vk::Image image; // null for buffers
+        vk::ImageSubresourceRange range;
+        Access initial;
+        std::optional<Access> final;
+        ResourceState state;
+    };
+
+    void cull();
+    void addBarrier(Barriers &barriers, Resource &resource, Access access);
+
+    std::pmr::memory_resource *memory = std::pmr::get_default_resource();
+    // keep their capacity across frames, the elements allocate from memory
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    std::optional<Barriers> finalBarriers;
+};
\ No newline at end of file
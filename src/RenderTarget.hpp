@@ -0,0 +1,10 @@
+#pragma once
+#include "Vulkan.hpp"
+
+// image the engine renders a frame into, either a swapchain image or an offscreen image
+struct RenderTarget
+{
+    uint32_t imageIndex;           // index to the image in its owner
+    vk::Image imageHandle;         // Handle to the image (not owned)
+    vk::UniqueImageView imageView; // View into the image
+};
\ No newline at end of file
@@ -1,11 +1,18 @@
 #include "ShaderObject.hpp"
 #include "Engine.hpp"
 #include "helpers.hpp"
+#include <algorithm>
 
-ShaderObject::ShaderObject(vk::Device device, std::string_view vertexShaderSpirvPath,
-                           std::string_view fragShaderSpirvPath)
+ShaderObject::ShaderObject(vk::Device device_, std::string_view vertexShaderSpirvPath,
+                           std::string_view fragShaderSpirvPath,
+                           std::span<vk::PushConstantRange const> pushConstantRanges)
+    : device(device_)
 {
-    shaders = helpers::vulkan::createShadersExtUnique(device, "triangle.vert.spv", "triangle.frag.spv");
+    shaders = helpers::vulkan::createShadersExtUnique(device, vertexShaderSpirvPath, fragShaderSpirvPath,
+                                                      pushConstantRanges);
+    pipelineLayout = device.createPipelineLayoutUnique(
+        vk::PipelineLayoutCreateInfo{.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size()),
+                                     .pPushConstantRanges = pushConstantRanges.data()});
 }
 
 void ShaderObject::bind(vk::CommandBuffer &commandBuffer)
@@ -13,37 +20,105 @@ void ShaderObject::bind(vk::CommandBuffer &commandBuffer)
     commandBuffer.bindShadersEXT({vk::ShaderStageFlagBits::eVertex, vk::ShaderStageFlagBits::eFragment},
                                  {shaders[0].get(), shaders[1].get()});
 }
+void ShaderObject::bind(vk::CommandBuffer &commandBuffer, DynamicStateTracker &tracker)
+{
+    if (tracker.bindShaders(shaders[0].get(), shaders[1].get()))
+        bind(commandBuffer);
+}
 void ShaderObject::setState(vk::CommandBuffer &commandBuffer)
 {
-    commandBuffer.setRasterizerDiscardEnable(rasterizerDiscardEnable);
-    commandBuffer.setPolygonModeEXT(polygonMode);
-    commandBuffer.setCullMode(cullMode);
-    commandBuffer.setFrontFace(frontFace);
-    commandBuffer.setDepthBiasEnable(depthBiasEnable);
+    DynamicStateTracker tracker;
+    setState(commandBuffer, tracker);
+}
+void ShaderObject::setState(vk::CommandBuffer &commandBuffer, DynamicStateTracker &tracker)
+{
+    tracker.apply(commandBuffer, state, vertexBindingDescriptions, vertexAttributeDescriptions);
+}
+
+void DynamicStateTracker::apply(vk::CommandBuffer commandBuffer, DynamicState const &state,
+                                std::span<vk::VertexInputBindingDescription2EXT const> vertexBindings,
+                                std::span<vk::VertexInputAttributeDescription2EXT const> vertexAttributes)
+{
+    // everything on the first apply, afterwards the draws of a scene mostly differ in a field or two
+    bool all = !valid;
+    auto differs = [all](auto const &current, auto const &previous) { return all or current != previous; };
 
-    commandBuffer.setDepthTestEnable(depthTestEnable);
-    commandBuffer.setDepthWriteEnable(depthWriteEnable);
-    commandBuffer.setDepthCompareOp(depthCompareOp);
-    commandBuffer.setStencilTestEnable(stencilTestEnable);
+    if (differs(state.rasterizerDiscardEnable, last.rasterizerDiscardEnable))
+        commandBuffer.setRasterizerDiscardEnable(state.rasterizerDiscardEnable);
+    if (differs(state.polygonMode, last.polygonMode))
+        commandBuffer.setPolygonModeEXT(state.polygonMode);
+    if (differs(state.cullMode, last.cullMode))
+        commandBuffer.setCullMode(state.cullMode);
+    if (differs(state.frontFace, last.frontFace))
+        commandBuffer.setFrontFace(state.frontFace);
+    if (differs(state.depthBiasEnable, last.depthBiasEnable))
+        commandBuffer.setDepthBiasEnable(state.depthBiasEnable);
 
-    commandBuffer.setViewportWithCount(viewport);
-    commandBuffer.setScissorWithCount(scissor);
+    if (differs(state.depthTestEnable, last.depthTestEnable))
+        commandBuffer.setDepthTestEnable(state.depthTestEnable);
+    if (differs(state.depthWriteEnable, last.depthWriteEnable))
+        commandBuffer.setDepthWriteEnable(state.depthWriteEnable);
+    if (differs(state.depthCompareOp, last.depthCompareOp))
+        commandBuffer.setDepthCompareOp(state.depthCompareOp);
+    if (differs(state.stencilTestEnable, last.stencilTestEnable))
+        commandBuffer.setStencilTestEnable(state.stencilTestEnable);
 
-    commandBuffer.setPrimitiveTopologyEXT(primitiveTopology);
-    commandBuffer.setPrimitiveRestartEnableEXT(primitiveRestartEnable);
+    if (differs(state.viewport, last.viewport))
+        commandBuffer.setViewportWithCount(state.viewport);
+    if (differs(state.scissor, last.scissor))
+        commandBuffer.setScissorWithCount(state.scissor);
 
-    commandBuffer.setVertexInputEXT(vertexBindingDescriptions.size(), vertexBindingDescriptions.data(),
-                                    vertexAttributeDescriptions.size(), vertexAttributeDescriptions.data());
+    if (differs(state.primitiveTopology, last.primitiveTopology))
+        commandBuffer.setPrimitiveTopologyEXT(state.primitiveTopology);
+    if (differs(state.primitiveRestartEnable, last.primitiveRestartEnable))
+        commandBuffer.setPrimitiveRestartEnableEXT(state.primitiveRestartEnable);
 
-    for (const auto &[attachment, enable] : colorBlendEnables)
+    // the same vectors when the draws use the same shader object, otherwise a few descriptions to compare
+    bool sameBindings = vertexBindings.data() == lastVertexBindings.data() and
+                        vertexBindings.size() == lastVertexBindings.size();
+    bool sameAttributes = vertexAttributes.data() == lastVertexAttributes.data() and
+                          vertexAttributes.size() == lastVertexAttributes.size();
+    if (all or !(sameBindings or std::ranges::equal(vertexBindings, lastVertexBindings)) or
+        !(sameAttributes or std::ranges::equal(vertexAttributes, lastVertexAttributes)))
     {
-        commandBuffer.setColorBlendEnableEXT(attachment, {enable});
+        commandBuffer.setVertexInputEXT(vertexBindings.size(), vertexBindings.data(), vertexAttributes.size(),
+                                        vertexAttributes.data());
     }
-    commandBuffer.setColorWriteMaskEXT(0, colorBlendEnables.size(), &colorWriteMask);
+    lastVertexBindings = vertexBindings;
+    lastVertexAttributes = vertexAttributes;
 
-    commandBuffer.setRasterizationSamplesEXT(rasterizationSamples);
-    commandBuffer.setSampleMaskEXT(rasterizationSamples, &sampleMask);
-    commandBuffer.setAlphaToCoverageEnableEXT(alphaToCoverageEnable);
+    auto count = state.colorAttachmentCount;
+    if (count > 0)
+    {
+        auto enables = std::span(state.colorBlendEnables).first(count);
+        if (differs(count, last.colorAttachmentCount) or
+            !std::ranges::equal(enables, std::span(last.colorBlendEnables).first(count)))
+            commandBuffer.setColorBlendEnableEXT(0, enables);
+        if (differs(count, last.colorAttachmentCount) or differs(state.colorWriteMask, last.colorWriteMask))
+        {
+            std::array<vk::ColorComponentFlags, DynamicState::maxColorAttachments> masks;
+            masks.fill(state.colorWriteMask);
+            commandBuffer.setColorWriteMaskEXT(0, std::span(masks).first(count));
+        }
+    }
+
+    // the mask's length depends on the sample count
+    if (differs(state.rasterizationSamples, last.rasterizationSamples))
+        commandBuffer.setRasterizationSamplesEXT(state.rasterizationSamples);
+    if (differs(state.rasterizationSamples, last.rasterizationSamples) or differs(state.sampleMask, last.sampleMask))
+        commandBuffer.setSampleMaskEXT(state.rasterizationSamples, &state.sampleMask);
+    if (differs(state.alphaToCoverageEnable, last.alphaToCoverageEnable))
+        commandBuffer.setAlphaToCoverageEnableEXT(state.alphaToCoverageEnable);
+
+    last = state;
+    valid = true;
+}
+bool DynamicStateTracker::bindShaders(vk::ShaderEXT vertexShader, vk::ShaderEXT fragmentShader)
+{
+    if (shaders[0] == vertexShader and shaders[1] == fragmentShader)
+        return false;
+    shaders = {vertexShader, fragmentShader};
+    return true;
 }
 
 std::vector<vk::VertexInputBindingDescription2EXT> &ShaderObject::vertexBindings()
@@ -58,77 +133,79 @@ std::vector<vk::VertexInputAttributeDescription2EXT> &ShaderObject::attributeDes
 // Setters
 void ShaderObject::setRasterizerDiscardEnable(VkBool32 enable)
 {
-    rasterizerDiscardEnable = enable;
+    state.rasterizerDiscardEnable = enable;
 }
 void ShaderObject::setPolygonMode(vk::PolygonMode mode)
 {
-    polygonMode = mode;
+    state.polygonMode = mode;
 }
 void ShaderObject::setCullMode(vk::CullModeFlags mode)
 {
-    cullMode = mode;
+    state.cullMode = mode;
 }
 void ShaderObject::setFrontFace(vk::FrontFace front)
 {
-    frontFace = front;
+    state.frontFace = front;
 }
 void ShaderObject::setDepthBiasEnable(VkBool32 enable)
 {
-    depthBiasEnable = enable;
+    state.depthBiasEnable = enable;
 }
 
 void ShaderObject::setDepthTestEnable(VkBool32 enable)
 {
-    depthTestEnable = enable;
+    state.depthTestEnable = enable;
 }
 void ShaderObject::setDepthWriteEnable(VkBool32 enable)
 {
-    depthWriteEnable = enable;
+    state.depthWriteEnable = enable;
 }
 void ShaderObject::setDepthCompareOp(vk::CompareOp op)
 {
-    depthCompareOp = op;
+    state.depthCompareOp = op;
 }
 void ShaderObject::setStencilTestEnable(VkBool32 enable)
 {
-    stencilTestEnable = enable;
+    state.stencilTestEnable = enable;
 }
 
 void ShaderObject::setPrimitiveTopology(vk::PrimitiveTopology topology)
 {
-    primitiveTopology = topology;
+    state.primitiveTopology = topology;
 }
 void ShaderObject::setPrimitiveRestartEnable(VkBool32 enable)
 {
-    primitiveRestartEnable = enable;
+    state.primitiveRestartEnable = enable;
 }
 
 void ShaderObject::setColorBlendEnable(uint32_t attachment, VkBool32 enable)
 {
-    colorBlendEnables[attachment] = enable;
+    CHECKTHROW(attachment < DynamicState::maxColorAttachments);
+    state.colorBlendEnables[attachment] = enable;
+    state.colorAttachmentCount = std::max(state.colorAttachmentCount, attachment + 1);
 }
 void ShaderObject::setColorWriteMask(vk::ColorComponentFlags mask)
 {
-    colorWriteMask = mask;
+    state.colorWriteMask = mask;
 }
 
 void ShaderObject::setRasterizationSamples(vk::SampleCountFlagBits samples)
 {
-    rasterizationSamples = samples;
+    state.rasterizationSamples = samples;
 }
 void ShaderObject::setSampleMask(uint32_t mask)
 {
-    sampleMask = mask;
+    state.sampleMask = mask;
 }
 void ShaderObject::setAlphaToCoverageEnable(VkBool32 enable)
 {
-    alphaToCoverageEnable = enable;
+    state.alphaToCoverageEnable = enable;
 }
 void ShaderObject::setViewport(vk::Viewport viewport_)
 {
-    viewport = viewport_;
+    state.viewport = viewport_;
 }
 void ShaderObject::setScissor(vk::Rect2D scissor_)
 {
-    scissor = scissor_;
+    state.scissor = scissor_;
 }
\ No newline at end of file
@@ -1,16 +1,90 @@
 #pragma once
 #include "Vulkan.hpp"
+#include <array>
 #include <concepts>
+#include <cstdint>
+#include <span>
 #include <string_view>
 #include <type_traits>
-#include <unordered_map>
+#include <vector>
+
+// everything setState emits, flat so a tracker can diff two of them field by field
+struct DynamicState
+{
+    static constexpr uint32_t maxColorAttachments = 8;
+
+    // Rasterizer
+    vk::Bool32 rasterizerDiscardEnable = false;
+    vk::PolygonMode polygonMode = vk::PolygonMode::eFill;
+    vk::CullModeFlags cullMode = vk::CullModeFlagBits::eNone;
+    vk::FrontFace frontFace = vk::FrontFace::eClockwise;
+    vk::Bool32 depthBiasEnable = false;
+
+    // Depth/Stencil
+    vk::Bool32 depthTestEnable = false;
+    vk::Bool32 depthWriteEnable = false;
+    vk::CompareOp depthCompareOp = vk::CompareOp::eAlways;
+    vk::Bool32 stencilTestEnable = false;
+
+    // Primitive
+    vk::PrimitiveTopology primitiveTopology = vk::PrimitiveTopology::eTriangleList;
+    vk::Bool32 primitiveRestartEnable = false;
+
+    // Blend, attachments [0, colorAttachmentCount) are set
+    uint32_t colorAttachmentCount = 0;
+    std::array<vk::Bool32, maxColorAttachments> colorBlendEnables{};
+    vk::ColorComponentFlags colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+                                             vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+
+    // MSAA
+    vk::SampleCountFlagBits rasterizationSamples = vk::SampleCountFlagBits::e1;
+    uint32_t sampleMask = 0xFFFFFFFF;
+    vk::Bool32 alphaToCoverageEnable = false;
+
+    // Viewport
+    vk::Viewport viewport;
+    vk::Rect2D scissor;
+};
+
+// what was last set on one command buffer, emits only what differs from it. state is undefined at the start of a
+// command buffer and after a pipeline bind, use a new tracker or reset() there. not thread safe, one per recording
+class DynamicStateTracker
+{
+  public:
+    void apply(vk::CommandBuffer commandBuffer, DynamicState const &state,
+               std::span<vk::VertexInputBindingDescription2EXT const> vertexBindings,
+               std::span<vk::VertexInputAttributeDescription2EXT const> vertexAttributes);
+    // false when the shaders are already bound
+    bool bindShaders(vk::ShaderEXT vertexShader, vk::ShaderEXT fragmentShader);
+    void reset()
+    {
+        valid = false;
+        shaders = {};
+    }
+
+  private:
+    bool valid = false;
+    DynamicState last;
+    // the shader objects' own descriptions, they are not modified while command buffers are recorded
+    std::span<vk::VertexInputBindingDescription2EXT const> lastVertexBindings;
+    std::span<vk::VertexInputAttributeDescription2EXT const> lastVertexAttributes;
+    std::array<vk::ShaderEXT, 2> shaders;
+};
 
 class ShaderObject
 {
   public:
     ShaderObject() = default;
-    ShaderObject(vk::Device device, std::string_view vertexShaderSpirvPath, std::string_view fragShaderSpirvPath);
+    // push constants are pushed with getPipelineLayout()
+    ShaderObject(vk::Device device, std::string_view vertexShaderSpirvPath, std::string_view fragShaderSpirvPath,
+                 std::span<vk::PushConstantRange const> pushConstantRanges = {});
     void bind(vk::CommandBuffer &commandBuffer);
+    // skips the bind when the tracker's command buffer has these shaders bound already
+    void bind(vk::CommandBuffer &commandBuffer, DynamicStateTracker &tracker);
+    vk::PipelineLayout getPipelineLayout()
+    {
+        return pipelineLayout.get();
+    }
 
     // Setters
     void setRasterizerDiscardEnable(vk::Bool32 enable);
@@ -39,44 +113,19 @@ class ShaderObject
     std::vector<vk::VertexInputBindingDescription2EXT> &vertexBindings();
     std::vector<vk::VertexInputAttributeDescription2EXT> &attributeDescriptions();
 
+    // emits all of the state
     void setState(vk::CommandBuffer &commandBuffer);
+    // emits what differs from the tracker's command buffer, the cheap path for many draws
+    void setState(vk::CommandBuffer &commandBuffer, DynamicStateTracker &tracker);
 
   private:
-    // Rasterizer
-    vk::Bool32 rasterizerDiscardEnable = false;
-    vk::PolygonMode polygonMode = vk::PolygonMode::eFill;
-    vk::CullModeFlags cullMode = vk::CullModeFlagBits::eNone;
-    vk::FrontFace frontFace = vk::FrontFace::eClockwise;
-    vk::Bool32 depthBiasEnable = false;
-
-    // Depth/Stencil
-    vk::Bool32 depthTestEnable = false;
-    vk::Bool32 depthWriteEnable = false;
-    vk::CompareOp depthCompareOp = vk::CompareOp::eAlways;
-    vk::Bool32 stencilTestEnable = false;
-
-    // Primitive
-    vk::PrimitiveTopology primitiveTopology = vk::PrimitiveTopology::eTriangleList;
-    vk::Bool32 primitiveRestartEnable = false;
-
-    // Blend
-    std::unordered_map<uint32_t, vk::Bool32> colorBlendEnables;
-    vk::ColorComponentFlags colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
-                                             vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
-
-    // MSAA
-    vk::SampleCountFlagBits rasterizationSamples = vk::SampleCountFlagBits::e1;
-    uint32_t sampleMask = 0xFFFFFFFF;
-    vk::Bool32 alphaToCoverageEnable = false;
-
-    // Viewport
-    vk::Viewport viewport;
-    vk::Rect2D scissor;
+    DynamicState state;
 
     // vertex bindings
     std::vector<vk::VertexInputBindingDescription2EXT> vertexBindingDescriptions;
     std::vector<vk::VertexInputAttributeDescription2EXT> vertexAttributeDescriptions;
 
     std::vector<vk::UniqueShaderEXT> shaders;
+    vk::UniquePipelineLayout pipelineLayout;
     vk::Device device;
 };
\ No newline at end of file
@@ -1,14 +1,20 @@
+#include "RenderTarget.hpp"
 #include "Vulkan.hpp"
 #include "helpers_vulkan.hpp"
+#include <chrono>
+#include <span>
 #include <vector>
 
 class Swapchain
 {
   public:
     Swapchain() = default;
+    // presentWait_ requires the device to have VK_KHR_present_id and VK_KHR_present_wait enabled
     Swapchain(vk::PhysicalDevice physicalDevice_, vk::Device device_, vk::SurfaceKHR surface_,
-              vk::Format requiredFormat)
-        : physicalDevice(physicalDevice_), device(device_), surface(surface_)
+              vk::Format requiredFormat, vk::PresentModeKHR preferredPresentMode_ = vk::PresentModeKHR::eFifo,
+              bool presentWait_ = false)
+        : physicalDevice(physicalDevice_), device(device_), surface(surface_),
+          preferredPresentMode(preferredPresentMode_), presentWait(presentWait_)
     {
         if (auto surfaceFormatResult = helpers::vulkan::getSurfaceFormat(physicalDevice, surface, requiredFormat);
             surfaceFormatResult.has_value())
@@ -20,8 +26,10 @@ class Swapchain
     Swapchain &operator=(Swapchain const &) = delete;
     Swapchain(Swapchain &&other)
         : physicalDevice(other.physicalDevice), device(other.device), surface(other.surface),
-          surfaceFormat(other.surfaceFormat), swapchain(std::move(other.swapchain)),
-          renderTargets(std::move(other.renderTargets))
+          surfaceFormat(other.surfaceFormat), preferredPresentMode(other.preferredPresentMode),
+          presentMode(other.presentMode), presentWait(other.presentWait), presentId(other.presentId),
+          firstPresentId(other.firstPresentId), outOfDate(other.outOfDate),
+          renderTargets(std::move(other.renderTargets)), swapchain(std::move(other.swapchain))
     {
     }
     Swapchain &operator=(Swapchain &&other)
@@ -34,6 +42,12 @@ class Swapchain
         device = other.device;
         surface = other.surface;
         surfaceFormat = other.surfaceFormat;
+        preferredPresentMode = other.preferredPresentMode;
+        presentMode = other.presentMode;
+        presentWait = other.presentWait;
+        presentId = other.presentId;
+        firstPresentId = other.firstPresentId;
+        outOfDate = other.outOfDate;
         swapchain = std::move(other.swapchain);
         renderTargets = std::move(other.renderTargets);
         return *this;
@@ -58,7 +72,16 @@ class Swapchain
         return desiredCount;
     }
 
-    void recreate(vk::Extent2D newExtent, std::vector<uint32_t> queueFamilyIndices)
+    using RenderTarget = ::RenderTarget;
+
+    // what a recreate replaced, frames still in flight may use it so it must outlive them
+    struct Retired
+    {
+        vk::UniqueSwapchainKHR swapchain;
+        std::vector<RenderTarget> renderTargets; // declared last so the views go before the swapchain
+    };
+
+    [[nodiscard]] Retired recreate(vk::Extent2D newExtent, std::span<uint32_t const> queueFamilyIndices)
     {
         auto surfaceCaps = physicalDevice.getSurfaceCapabilitiesKHR(surface);
 
@@ -66,6 +89,7 @@ class Swapchain
         auto oldSwapchain = swapchain.get();
 
         auto requiredImageCount = getRequiredImageCount();
+        presentMode = helpers::vulkan::choosePresentMode(physicalDevice, surface, preferredPresentMode);
         vk::SwapchainCreateInfoKHR swapchainCreateInfo{.surface = surface,
                                                        .minImageCount = requiredImageCount,
                                                        .imageFormat = surfaceFormat.format,
@@ -80,18 +104,22 @@ class Swapchain
                                                        .pQueueFamilyIndices = queueFamilyIndices.data(),
                                                        .preTransform = vk::SurfaceTransformFlagBitsKHR::eIdentity,
                                                        .compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque,
-                                                       .presentMode = vk::PresentModeKHR::eFifo,
+                                                       .presentMode = presentMode,
                                                        .clipped = false,
                                                        .oldSwapchain = oldSwapchain};
 
         // Create new swapchain
         auto newSwapchain = device.createSwapchainKHRUnique(swapchainCreateInfo);
 
-        // Clear old render targets before creating new ones
-        cleanupRenderTargets();
+        // hand the old swapchain and views to the caller instead of destroying them under the gpu
+        Retired retired{std::move(swapchain), std::move(renderTargets)};
+        renderTargets.clear();
 
         // Assign the new swapchain
         swapchain = std::move(newSwapchain);
+        // ids keep counting up, the ones before belong to the retired swapchain
+        firstPresentId = presentId + 1;
+        outOfDate = false;
 
         // Get the new swapchain images
         auto swapchainImages = device.getSwapchainImagesKHR(swapchain.get());
@@ -121,16 +149,11 @@ class Swapchain
             renderTargets[i].imageView = device.createImageViewUnique(imageViewCreateInfo);
         }
 
-        std::println("swapchain re/created with {} images", renderTargets.size());
+        std::println("swapchain re/created with {} images, present mode {}", renderTargets.size(),
+                     vk::to_string(presentMode));
+        return retired;
     }
 
-    struct RenderTarget
-    {
-        uint32_t imageIndex;           // index to the swapchain image
-        vk::Image imageHandle;         // Handle to the swapchain image (not owned)
-        vk::UniqueImageView imageView; // View into the image
-    };
-
     RenderTarget &getRenderTarget(uint32_t renderTargetIndex)
     {
         if (renderTargetIndex >= renderTargets.size())
@@ -170,16 +193,68 @@ class Swapchain
         }
     }
 
-    void presentImage(vk::Queue presentQueue, uint32_t imageIndex, vk::Semaphore waitSemaphore)
+    // returns the present id to wait for, 0 without present wait
+    uint64_t presentImage(vk::Queue presentQueue, uint32_t imageIndex, vk::Semaphore waitSemaphore)
     {
-        vk::PresentInfoKHR presentInfo = {.waitSemaphoreCount = 1,
+        uint64_t id = presentWait ? ++presentId : 0;
+        vk::PresentIdKHR presentIdInfo{.swapchainCount = 1, .pPresentIds = &id};
+        vk::PresentInfoKHR presentInfo = {.pNext = presentWait ? &presentIdInfo : nullptr,
+                                          .waitSemaphoreCount = 1,
                                           .pWaitSemaphores = &waitSemaphore,
                                           .swapchainCount = 1,
                                           .pSwapchains = &swapchain.get(),
                                           .pImageIndices = &imageIndex};
 
-        if (presentQueue.presentKHR(presentInfo) != vk::Result::eSuccess)
-            throw Core::runtime_error("present queue presentKHR failed!");
+        // the semaphore wait still happens when out of date, the caller only has to recreate before the next frame
+        try
+        {
+            if (presentQueue.presentKHR(presentInfo) == vk::Result::eSuboptimalKHR)
+                outOfDate = true;
+        }
+        catch (vk::OutOfDateKHRError const &)
+        {
+            outOfDate = true;
+        }
+        return id;
+    }
+
+    // the last present reported the swapchain suboptimal or out of date
+    bool isOutOfDate() const
+    {
+        return outOfDate;
+    }
+
+    // true once the present with presentId is visible, or its swapchain was replaced. false on timeout
+    bool waitForPresent(uint64_t id, std::chrono::nanoseconds timeout)
+    {
+        if (!presentWait or id < firstPresentId)
+            return true;
+        try
+        {
+            return device.waitForPresentKHR(swapchain.get(), id, timeout.count()) != vk::Result::eTimeout;
+        }
+        catch (vk::OutOfDateKHRError const &)
+        {
+            return true;
+        }
+    }
+
+    // takes effect on the next recreate, falls back to what the surface supports
+    void setPreferredPresentMode(vk::PresentModeKHR mode)
+    {
+        preferredPresentMode = mode;
+    }
+    vk::PresentModeKHR getPresentMode() const
+    {
+        return presentMode;
+    }
+    std::vector<vk::PresentModeKHR> getSupportedPresentModes() const
+    {
+        return physicalDevice.getSurfacePresentModesKHR(surface);
+    }
+    bool isPresentWaitEnabled() const
+    {
+        return presentWait;
     }
 
     bool isValid() const
@@ -206,6 +281,12 @@ class Swapchain
     vk::Device device;
     vk::SurfaceKHR surface;
     vk::SurfaceFormatKHR surfaceFormat;
+    vk::PresentModeKHR preferredPresentMode = vk::PresentModeKHR::eFifo;
+    vk::PresentModeKHR presentMode = vk::PresentModeKHR::eFifo; // what the surface gave us
+    bool presentWait = false;
+    uint64_t presentId = 0;      // last id handed out
+    uint64_t firstPresentId = 1; // first id of the current swapchain
+    bool outOfDate = false;
     std::vector<RenderTarget> renderTargets;
     vk::UniqueSwapchainKHR swapchain;
 };
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "TransferQueue.hpp"
+#include "CpuTracer.hpp"
+#include <memory_resource>
+#include <vector>
+
+TransferQueue::TransferQueue(vk::Device device_, uint32_t transferFamilyIndex_, uint32_t graphicsFamilyIndex_)
+    : device(device_), transferFamilyIndex(transferFamilyIndex_), graphicsFamilyIndex(graphicsFamilyIndex_),
+      queue(device.getQueue(transferFamilyIndex, 0)), timeline(device)
+{
+    commandPool = device.createCommandPoolUnique(vk::CommandPoolCreateInfo{
+        .flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer | vk::CommandPoolCreateFlagBits::eTransient,
+        .queueFamilyIndex = transferFamilyIndex,
+    });
+}
+
+vk::BufferMemoryBarrier2 TransferQueue::ownershipBarrier(vk::Buffer buffer)
+{
+    return vk::BufferMemoryBarrier2{.srcQueueFamilyIndex = transferFamilyIndex,
+                                    .dstQueueFamilyIndex = graphicsFamilyIndex,
+                                    .buffer = buffer,
+                                    .offset = 0,
+                                    .size = vk::WholeSize};
+}
+
+uint64_t TransferQueue::submit(RecordFunction const &record, std::span<vk::Buffer const> writtenBuffers,
+                               std::pmr::memory_resource *memory)
+{
+    NDEEX_TRACE_FUNCTION();
+    vk::UniqueCommandBuffer commandBuffer;
+    if (!submissions.empty() and timeline.isComplete(submissions.front().value))
+    {
+        commandBuffer = std::move(submissions.front().commandBuffer);
+        submissions.pop_front();
+        commandBuffer->reset();
+    }
+    else
+    {
+        commandBuffer = std::move(device.allocateCommandBuffersUnique(vk::CommandBufferAllocateInfo{
+            .commandPool = commandPool.get(), .level = vk::CommandBufferLevel::ePrimary, .commandBufferCount = 1})[0]);
+    }
+
+    auto cmd = commandBuffer.get();
+    cmd.begin(vk::CommandBufferBeginInfo{.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    record(cmd);
+    // release half of the ownership transfer, the destination scope is ignored
+    std::pmr::vector<vk::BufferMemoryBarrier2> barriers(memory);
+    barriers.reserve(writtenBuffers.size());
+    for (auto buffer : writtenBuffers)
+    {
+        auto &barrier = barriers.emplace_back(ownershipBarrier(buffer));
+        barrier.srcStageMask = vk::PipelineStageFlagBits2::eCopy;
+        barrier.srcAccessMask = vk::AccessFlagBits2::eTransferWrite;
+    }
+    cmd.pipelineBarrier2(vk::DependencyInfo{.bufferMemoryBarrierCount = static_cast<uint32_t>(barriers.size()),
+                                            .pBufferMemoryBarriers = barriers.data()});
+    cmd.end();
+
+    auto value = timeline.nextValue();
+    auto signalSemaphore = timeline.getHandle();
+    vk::TimelineSemaphoreSubmitInfo timelineSubmitInfo{.signalSemaphoreValueCount = 1,
+                                                       .pSignalSemaphoreValues = &value};
+    queue.submit(vk::SubmitInfo{.pNext = &timelineSubmitInfo,
+                                .commandBufferCount = 1,
+                                .pCommandBuffers = &cmd,
+                                .signalSemaphoreCount = 1,
+                                .pSignalSemaphores = &signalSemaphore});
+    submissions.push_back(Submission{value, std::move(commandBuffer)});
+    return value;
+}
+
+void TransferQueue::recordAcquire(vk::CommandBuffer cmd, std::span<vk::Buffer const> buffers,
+                                  vk::PipelineStageFlags2 dstStages, vk::AccessFlags2 dstAccess,
+                                  std::pmr::memory_resource *memory)
+{
+    // source scope is ignored for the acquire, the stages of the semaphore wait chain it after the transfer
+    std::pmr::vector<vk::BufferMemoryBarrier2> barriers(memory);
+    barriers.reserve(buffers.size());
+    for (auto buffer : buffers)
+    {
+        auto &barrier = barriers.emplace_back(ownershipBarrier(buffer));
+        barrier.srcStageMask = dstStages;
+        barrier.dstStageMask = dstStages;
+        barrier.dstAccessMask = dstAccess;
+    }
+    cmd.pipelineBarrier2(vk::DependencyInfo{.bufferMemoryBarrierCount = static_cast<uint32_t>(barriers.size()),
+                                            .pBufferMemoryBarriers = barriers.data()});
+}
\ No newline at end of file
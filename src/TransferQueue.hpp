@@ -0,0 +1,51 @@
+#pragma once
+#include "GpuTimeline.hpp"
+#include "Vulkan.hpp"
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory_resource>
+#include <span>
+
+// copies submitted on a dedicated transfer queue family so they run next to rendering instead of taking graphics
+// queue time. buffers are exclusive to one family: a submission releases what it wrote to the graphics family, the
+// graphics side waits on the returned timeline value and acquires the buffers before it first reads them
+class TransferQueue
+{
+  public:
+    using RecordFunction = std::function<void(vk::CommandBuffer)>;
+
+    TransferQueue(vk::Device device, uint32_t transferFamilyIndex, uint32_t graphicsFamilyIndex);
+
+    // records the copies, releases writtenBuffers and submits. returns the value getTimeline() reaches once done.
+    // the barriers are built in memory, e.g. the frame arena
+    uint64_t submit(RecordFunction const &record, std::span<vk::Buffer const> writtenBuffers,
+                    std::pmr::memory_resource *memory = std::pmr::get_default_resource());
+    // graphics side of the ownership transfer. the graphics submission waits on the value at dstStages, the
+    // acquire chains after that wait
+    void recordAcquire(vk::CommandBuffer cmd, std::span<vk::Buffer const> buffers, vk::PipelineStageFlags2 dstStages,
+                       vk::AccessFlags2 dstAccess,
+                       std::pmr::memory_resource *memory = std::pmr::get_default_resource());
+
+    GpuTimeline &getTimeline()
+    {
+        return timeline;
+    }
+
+  private:
+    vk::BufferMemoryBarrier2 ownershipBarrier(vk::Buffer buffer);
+
+    struct Submission
+    {
+        uint64_t value;
+        vk::UniqueCommandBuffer commandBuffer;
+    };
+
+    vk::Device device;
+    uint32_t transferFamilyIndex;
+    uint32_t graphicsFamilyIndex;
+    vk::Queue queue;
+    vk::UniqueCommandPool commandPool;
+    GpuTimeline timeline;
+    std::deque<Submission> submissions; // oldest first, command buffers are reused once their value completed
+};
\ No newline at end of file
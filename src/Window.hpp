@@ -1,8 +1,10 @@
 #pragma once
 
 #include "SDL3/SDL_video.h"
+#if defined(_WIN32)
 #include <Windows.h>
 #undef min
+#endif
 #include "Vulkan.hpp"
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_vulkan.h>
@@ -0,0 +1,520 @@
+#include "Engine.hpp"
+#include "MeshOptimizer.hpp"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <print>
+#include <span>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// headless scripted benchmark scenes with a baseline regression check, see printUsage.
+// runs on any vulkan device including lavapipe, device selection falls back to cpu devices
+namespace
+{
+using Vertex = Core::Engine::Vertex;
+using SceneDraw = Core::Engine::SceneDraw;
+using Results = std::map<std::string, std::map<std::string, double>>; // scene -> metric -> value
+
+void printUsage()
+{
+    std::println("usage: ndeex_bench [--scene name|all] [--frames n] [--warmup n] [--width w] [--height h]\n"
+                 "                   [--baseline file] [--write-baseline file] [--threshold fraction]\n"
+                 "                   [--recording-threads n] [--vertex-pulling 0|1] [--cpu-trace file]\n"
+                 "fails when a metric is above baseline * (1 + threshold), default threshold 0.1");
+}
+
+struct Summary
+{
+    double min;
+    double mean;
+    double p99;
+};
+
+Summary summarize(std::vector<double> samples)
+{
+    if (samples.empty())
+        return {};
+
+    std::ranges::sort(samples);
+    auto p99Index = static_cast<size_t>(std::ceil(0.99 * static_cast<double>(samples.size()))) - 1;
+    return Summary{
+        .min = samples.front(),
+        .mean = std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(samples.size()),
+        .p99 = samples[p99Index],
+    };
+}
+
+void printSummary(std::string_view name, std::vector<double> const &samples)
+{
+    if (samples.empty())
+    {
+        std::println("  {:<4} no samples", name);
+        return;
+    }
+    auto summary = summarize(samples);
+    std::println("  {:<4} min {:8.3f} ms  mean {:8.3f} ms  p99 {:8.3f} ms  ({} frames)", name, summary.min,
+                 summary.mean, summary.p99, samples.size());
+}
+
+// scenes are deterministic, no clocks or random seeds, so runs are comparable
+struct Scene
+{
+    std::string name;
+    std::function<void(Core::Engine &)> setup;
+    std::function<void(Core::Engine &, size_t frame)> update; // optional, called before every frame
+};
+
+Vertex gridVertex(uint32_t x, uint32_t y, uint32_t cells)
+{
+    auto step = 2.f / static_cast<float>(cells);
+    return Vertex{.position = {-1.f + step * static_cast<float>(x), -1.f + step * static_cast<float>(y)},
+                  .color = {static_cast<float>(x) / static_cast<float>(cells),
+                            static_cast<float>(y) / static_cast<float>(cells), 0.5f}};
+}
+
+// cells * cells * 2 triangles as a plain triangle list
+std::vector<Vertex> makeGrid(uint32_t cells)
+{
+    std::vector<Vertex> vertices;
+    vertices.reserve(size_t{cells} * cells * 6);
+    for (uint32_t y = 0; y < cells; ++y)
+    {
+        for (uint32_t x = 0; x < cells; ++x)
+        {
+            vertices.push_back(gridVertex(x, y, cells));
+            vertices.push_back(gridVertex(x + 1, y, cells));
+            vertices.push_back(gridVertex(x, y + 1, cells));
+            vertices.push_back(gridVertex(x + 1, y, cells));
+            vertices.push_back(gridVertex(x + 1, y + 1, cells));
+            vertices.push_back(gridVertex(x, y + 1, cells));
+        }
+    }
+    return vertices;
+}
+
+std::vector<Scene> makeScenes()
+{
+    std::vector<Scene> scenes;
+
+    // ~1M triangles uploaded once into device local memory, measures raw vertex throughput
+    scenes.push_back(Scene{
+        .name = "static_mesh_1m",
+        .setup =
+            [](Core::Engine &engine) {
+                auto vertices = makeGrid(708);
+                auto vertexCount = static_cast<uint32_t>(vertices.size());
+                engine.setScene(std::move(vertices), {SceneDraw{0, vertexCount}},
+                                vk::PrimitiveTopology::eTriangleList, Core::Engine::VertexMode::eStatic);
+            },
+    });
+
+    // the same mesh deduplicated and optimized, measures what indexing saves in vertex work and memory
+    scenes.push_back(Scene{
+        .name = "indexed_mesh_1m",
+        .setup =
+            [](Core::Engine &engine) {
+                auto vertices = makeGrid(708);
+                auto indices = Core::mesh::deduplicate(vertices);
+                auto indexCount = static_cast<uint32_t>(indices.size());
+                std::array ranges{Core::mesh::IndexRange{0, indexCount}};
+                Core::mesh::optimize(vertices, indices, ranges, [](Vertex const &vertex) {
+                    return std::array{vertex.position[0], vertex.position[1], 0.f};
+                });
+                engine.setIndexedScene(std::move(vertices), std::move(indices), {SceneDraw{0, indexCount}},
+                                       vk::PrimitiveTopology::eTriangleList, Core::Engine::VertexMode::eStatic);
+            },
+    });
+
+    // 10k one triangle draws, measures per draw cpu cost and secondary recording
+    scenes.push_back(Scene{
+        .name = "small_draws_10k",
+        .setup =
+            [](Core::Engine &engine) {
+                constexpr uint32_t drawCount = 10'000;
+                auto vertices = makeGrid(50); // 5000 cells -> 10k triangles
+                std::vector<SceneDraw> draws;
+                draws.reserve(drawCount);
+                for (uint32_t i = 0; i < drawCount; ++i)
+                    draws.push_back(SceneDraw{i * 3, 3, i % 2 == 1});
+                engine.setScene(std::move(vertices), draws);
+            },
+    });
+
+    // the triangles of small_draws_10k as 10k meshes of the geometry arena, one bind and multi draw indirect
+    scenes.push_back(Scene{
+        .name = "mesh_arena_10k",
+        .setup =
+            [](Core::Engine &engine) {
+                constexpr uint32_t meshCount = 10'000;
+                auto vertices = makeGrid(50);
+                std::array<uint32_t, 3> indices{0, 1, 2};
+                std::vector<Core::Engine::MeshDraw> draws;
+                draws.reserve(meshCount);
+                for (uint32_t i = 0; i < meshCount; ++i)
+                {
+                    auto mesh = engine.addMesh(std::span(vertices).subspan(size_t{i} * 3, 3), indices);
+                    draws.push_back(Core::Engine::MeshDraw{mesh, i >= meshCount / 2});
+                }
+                engine.setMeshScene(draws);
+            },
+    });
+
+    // ~100k triangles rewritten and fully uploaded every frame
+    scenes.push_back(Scene{
+        .name = "vertex_rewrite",
+        .setup =
+            [](Core::Engine &engine) {
+                auto vertices = makeGrid(224);
+                auto vertexCount = static_cast<uint32_t>(vertices.size());
+                engine.setScene(std::move(vertices), {SceneDraw{0, vertexCount}});
+            },
+        .update =
+            [](Core::Engine &engine, size_t frame) {
+                auto offset = 0.01f * static_cast<float>(frame % 100);
+                for (auto &vertex : engine.sceneVertices())
+                    vertex.color[2] = offset;
+                engine.markVerticesDirty(0);
+            },
+    });
+
+    // same workload written straight into mapped memory, no cpu copy or staging
+    scenes.push_back(Scene{
+        .name = "vertex_stream_mapped",
+        .setup =
+            [](Core::Engine &engine) {
+                auto grid = std::make_shared<std::vector<Vertex> const>(makeGrid(224));
+                auto vertexCount = static_cast<uint32_t>(grid->size());
+                auto writer = [grid](std::span<Vertex> vertices, uint64_t frame) {
+                    // write only, reading back mapped memory may be uncached
+                    auto offset = 0.01f * static_cast<float>(frame % 100);
+                    for (size_t i = 0; i < vertices.size(); ++i)
+                    {
+                        auto const &source = (*grid)[i];
+                        vertices[i] = Vertex{.position = source.position,
+                                             .color = {source.color[0], source.color[1], offset}};
+                    }
+                };
+                engine.setStreamedScene(vertexCount, {SceneDraw{0, vertexCount}}, writer);
+            },
+    });
+
+    // several resize requests per frame, only the last one should cause a recreation
+    scenes.push_back(Scene{
+        .name = "resize_storm",
+        .setup = [](Core::Engine &) {},
+        .update =
+            [](Core::Engine &engine, size_t frame) {
+                constexpr std::array<vk::Extent2D, 4> extents{
+                    vk::Extent2D{640, 480}, vk::Extent2D{1024, 800}, vk::Extent2D{800, 600}, vk::Extent2D{1280, 720}};
+                for (size_t i = 0; i < 3; ++i)
+                {
+                    auto extent = extents[(frame + i) % extents.size()];
+                    engine.resize(extent.width, extent.height);
+                }
+            },
+    });
+
+    return scenes;
+}
+
+struct Options
+{
+    std::string scene = "all";
+    size_t frames = 300;
+    size_t warmup = 30;
+    uint32_t width = 1024;
+    uint32_t height = 800;
+    uint32_t recordingThreads = 0;
+    bool vertexPulling = false;
+    double threshold = 0.1;
+    std::filesystem::path baselinePath;
+    std::filesystem::path writeBaselinePath;
+    std::filesystem::path cpuTracePath;
+};
+
+Options parseOptions(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg = argv[i];
+        if (arg == "--help" or arg == "-h")
+        {
+            printUsage();
+            std::exit(0);
+        }
+        if (i + 1 >= argc)
+            throw Core::runtime_error("missing value for {}", arg);
+        std::string value = argv[++i];
+        if (arg == "--scene")
+            options.scene = value;
+        else if (arg == "--frames")
+            options.frames = std::stoul(value);
+        else if (arg == "--warmup")
+            options.warmup = std::stoul(value);
+        else if (arg == "--width")
+            options.width = static_cast<uint32_t>(std::stoul(value));
+        else if (arg == "--height")
+            options.height = static_cast<uint32_t>(std::stoul(value));
+        else if (arg == "--recording-threads")
+            options.recordingThreads = static_cast<uint32_t>(std::stoul(value));
+        else if (arg == "--vertex-pulling")
+            options.vertexPulling = value != "0";
+        else if (arg == "--threshold")
+            options.threshold = std::stod(value);
+        else if (arg == "--baseline")
+            options.baselinePath = value;
+        else if (arg == "--write-baseline")
+            options.writeBaselinePath = value;
+        else if (arg == "--cpu-trace")
+            options.cpuTracePath = value;
+        else
+            throw Core::runtime_error("unknown option {}", arg);
+    }
+    return options;
+}
+
+std::map<std::string, double> runScene(Scene const &scene, Options const &options)
+{
+    Core::Engine engine{Core::EngineCreateInfo{
+        .width = options.width,
+        .height = options.height,
+        .title = "ndeex_bench",
+        .headless = true,
+        .recordingThreads = options.recordingThreads,
+        .cpuTracePath = options.cpuTracePath,
+        .vertexPulling = options.vertexPulling,
+    }};
+    scene.setup(engine);
+
+    std::vector<double> cpuFrameTimes;
+    std::vector<double> gpuFrameTimes;
+    cpuFrameTimes.reserve(options.frames);
+    gpuFrameTimes.reserve(options.frames);
+
+    uint64_t lastGpuFrame = ~0ull;
+    for (size_t frame = 0; frame < options.warmup + options.frames; frame++)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        if (scene.update)
+            scene.update(engine, frame);
+        engine.renderFrame();
+        auto end = std::chrono::steady_clock::now();
+        if (frame < options.warmup)
+            continue;
+        cpuFrameTimes.push_back(std::chrono::duration<double, std::milli>(end - begin).count());
+
+        // reported frames-in-flight late, once the gpu is done with it
+        auto const *result = engine.getGpuProfiler().getLatestResult();
+        if (result and !result->zones.empty() and result->frameNumber != lastGpuFrame)
+        {
+            gpuFrameTimes.push_back(result->zones.front().durationMs);
+            lastGpuFrame = result->frameNumber;
+        }
+    }
+
+    std::println("{} ({} frames at {}x{})", scene.name, options.frames, options.width, options.height);
+    printSummary("cpu", cpuFrameTimes);
+    printSummary("gpu", gpuFrameTimes);
+
+    auto cpu = summarize(cpuFrameTimes);
+    // draw commands of the last frame as the api saw them, a run of meshes in one multi draw counts once
+    std::map<std::string, double> metrics{{"cpu_mean_ms", cpu.mean},
+                                          {"cpu_p99_ms", cpu.p99},
+                                          {"draw_calls", engine.getMetrics().gauge("draw_calls").get()}};
+    if (!gpuFrameTimes.empty())
+    {
+        auto gpu = summarize(gpuFrameTimes);
+        metrics["gpu_mean_ms"] = gpu.mean;
+        metrics["gpu_p99_ms"] = gpu.p99;
+    }
+    return metrics;
+}
+
+// reads the subset of json written by writeBaseline: nested objects of strings and numbers
+class BaselineReader
+{
+  public:
+    explicit BaselineReader(std::string text) : text(std::move(text))
+    {
+    }
+
+    Results read()
+    {
+        Results results;
+        readObject([&](std::string const &key) {
+            if (key != "scenes")
+                throw Core::runtime_error("baseline: unexpected key {}", key);
+            readObject([&](std::string const &scene) {
+                readObject([&](std::string const &metric) { results[scene][metric] = readNumber(); });
+            });
+        });
+        return results;
+    }
+
+  private:
+    void skipWhitespace()
+    {
+        while (pos < text.size() and std::isspace(static_cast<unsigned char>(text[pos])))
+            ++pos;
+    }
+    void expect(char c)
+    {
+        skipWhitespace();
+        if (pos >= text.size() or text[pos] != c)
+            throw Core::runtime_error("baseline: expected '{}' at offset {}", c, pos);
+        ++pos;
+    }
+    bool consume(char c)
+    {
+        skipWhitespace();
+        if (pos < text.size() and text[pos] == c)
+        {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+    std::string readString()
+    {
+        expect('"');
+        auto end = text.find('"', pos);
+        if (end == std::string::npos)
+            throw Core::runtime_error("baseline: unterminated string");
+        auto str = text.substr(pos, end - pos);
+        pos = end + 1;
+        return str;
+    }
+    double readNumber()
+    {
+        skipWhitespace();
+        size_t length = 0;
+        auto value = std::stod(text.substr(pos), &length);
+        pos += length;
+        return value;
+    }
+    void readObject(std::function<void(std::string const &)> const &readMember)
+    {
+        expect('{');
+        if (consume('}'))
+            return;
+        do
+        {
+            auto key = readString();
+            expect(':');
+            readMember(key);
+        } while (consume(','));
+        expect('}');
+    }
+
+    std::string text;
+    size_t pos = 0;
+};
+
+Results readBaseline(std::filesystem::path const &path)
+{
+    std::ifstream file(path);
+    if (!file)
+        throw Core::runtime_error("cannot open baseline {}", path.string());
+    std::stringstream stream;
+    stream << file.rdbuf();
+    return BaselineReader(stream.str()).read();
+}
+
+void writeBaseline(std::filesystem::path const &path, Results const &results)
+{
+    std::ofstream file(path);
+    if (!file)
+        throw Core::runtime_error("cannot write baseline {}", path.string());
+    std::println(file, "{{\n  \"scenes\": {{");
+    for (size_t sceneIndex = 0; auto const &[scene, metrics] : results)
+    {
+        std::println(file, "    \"{}\": {{", scene);
+        for (size_t metricIndex = 0; auto const &[metric, value] : metrics)
+        {
+            std::println(file, "      \"{}\": {:.4f}{}", metric, value, ++metricIndex < metrics.size() ? "," : "");
+        }
+        std::println(file, "    }}{}", ++sceneIndex < results.size() ? "," : "");
+    }
+    std::println(file, "  }}\n}}");
+}
+
+// returns the number of regressions, scenes or metrics missing from either side are skipped
+size_t compare(Results const &results, Results const &baseline, double threshold)
+{
+    size_t regressions = 0;
+    for (auto const &[scene, metrics] : results)
+    {
+        auto baselineScene = baseline.find(scene);
+        if (baselineScene == baseline.end())
+        {
+            std::println("{}: not in baseline, skipped", scene);
+            continue;
+        }
+        for (auto const &[metric, value] : metrics)
+        {
+            auto baselineMetric = baselineScene->second.find(metric);
+            if (baselineMetric == baselineScene->second.end())
+                continue;
+            auto limit = baselineMetric->second * (1.0 + threshold);
+            bool regressed = value > limit;
+            regressions += regressed;
+            std::println("{:<16} {:<12} {:8.3f} baseline {:8.3f} limit {:8.3f} {}", scene, metric, value,
+                         baselineMetric->second, limit, regressed ? "REGRESSION" : "ok");
+        }
+    }
+    return regressions;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        auto options = parseOptions(argc, argv);
+
+        auto scenes = makeScenes();
+        if (options.scene != "all")
+        {
+            std::erase_if(scenes, [&](Scene const &scene) { return scene.name != options.scene; });
+            if (scenes.empty())
+                throw Core::runtime_error("unknown scene {}", options.scene);
+        }
+
+        Results results;
+        for (auto const &scene : scenes)
+            results[scene.name] = runScene(scene, options);
+
+        if (!options.writeBaselinePath.empty())
+        {
+            writeBaseline(options.writeBaselinePath, results);
+            std::println("baseline written to {}", options.writeBaselinePath.string());
+        }
+
+        if (!options.baselinePath.empty())
+        {
+            auto regressions = compare(results, readBaseline(options.baselinePath), options.threshold);
+            if (regressions > 0)
+            {
+                std::println("{} metrics regressed more than {:.0f}%", regressions, options.threshold * 100.0);
+                return 2;
+            }
+        }
+    }
+    catch (std::exception const &exception)
+    {
+        std::println("exception thrown was not handled: \n what():{}", exception.what());
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -1,6 +1,8 @@
 #pragma once
 #include "Exception.hpp"
 #include "SDL3/SDL_error.h"
+#include <string>
+#include <string_view>
 #include <utility>
 
 namespace helpers
@@ -18,6 +20,19 @@ template <typename T, size_t size, typename F> auto initArr(F &&f)
     return detail::initArr_impl<T, size>(std::forward<F>(f), std::make_index_sequence<size>{});
 }
 
+// quotes and backslashes escaped for a json string, used by the chrome trace writers
+inline std::string escapeJson(std::string_view text)
+{
+    std::string escaped;
+    for (char c : text)
+    {
+        if (c == '"' or c == '\\')
+            escaped.push_back('\\');
+        escaped.push_back(c);
+    }
+    return escaped;
+}
+
 template <typename T> void print_type_name()
 {
     static_assert(sizeof(T) == 0, "Type is:");
@@ -65,11 +65,10 @@ vk::Instance helpers::vulkan::create_instance(const std::string_view appName, ui
     VULKAN_HPP_DEFAULT_DISPATCHER.init(vkInstance);
     return vkInstance;
 }
-helpers::vulkan::DeviceQueueSelection helpers::vulkan::getFirstSupportedDeviceQueueSelection(
+static std::optional<helpers::vulkan::DeviceQueueSelection> findDeviceQueueSelection(
     vk::Instance instance, vk::PhysicalDeviceType physicalDeviceType, vk::QueueFlags requiredFlags,
     std::optional<vk::SurfaceKHR> surface)
 {
-    auto physicalDevices = instance.enumeratePhysicalDevices();
     for (auto physicalDevice : instance.enumeratePhysicalDevices())
     {
         if (physicalDevice.getProperties().deviceType != physicalDeviceType)
@@ -87,17 +86,38 @@ helpers::vulkan::DeviceQueueSelection helpers::vulkan::getFirstSupportedDeviceQu
                         })
                         .value_or(true);
                 if (surfacePresentSupport)
-                    return DeviceQueueSelection{physicalDevice, queueFamilyIndex};
+                    return helpers::vulkan::DeviceQueueSelection{physicalDevice, queueFamilyIndex};
             }
             queueFamilyIndex++;
         }
     }
+    return std::nullopt;
+}
+helpers::vulkan::DeviceQueueSelection helpers::vulkan::getFirstSupportedDeviceQueueSelection(
+    vk::Instance instance, vk::PhysicalDeviceType physicalDeviceType, vk::QueueFlags requiredFlags,
+    std::optional<vk::SurfaceKHR> surface)
+{
+    if (auto selection = findDeviceQueueSelection(instance, physicalDeviceType, requiredFlags, surface))
+        return selection.value();
+
+    throw Core::runtime_error("no physical device and queue combination found!");
+}
+helpers::vulkan::DeviceQueueSelection helpers::vulkan::getFirstSupportedDeviceQueueSelection(
+    vk::Instance instance, std::span<vk::PhysicalDeviceType const> physicalDeviceTypes, vk::QueueFlags requiredFlags,
+    std::optional<vk::SurfaceKHR> surface)
+{
+    for (auto physicalDeviceType : physicalDeviceTypes)
+    {
+        if (auto selection = findDeviceQueueSelection(instance, physicalDeviceType, requiredFlags, surface))
+            return selection.value();
+    }
 
     throw Core::runtime_error("no physical device and queue combination found!");
 }
 vk::Device helpers::vulkan::create_device(DeviceQueueSelection deviceQueue,
                                           std::vector<const char *> requiredDeviceExtensions,
-                                          std::vector<const char *> requiredDeviceLayers)
+                                          std::vector<const char *> requiredDeviceLayers, void *optionalFeatures,
+                                          std::span<uint32_t const> extraQueueFamilyIndices)
 {
     std::vector<vk::ExtensionProperties> availableExtensionProps =
         deviceQueue.physicalDevice.enumerateDeviceExtensionProperties();
@@ -124,14 +144,28 @@ vk::Device helpers::vulkan::create_device(DeviceQueueSelection deviceQueue,
     }
 
     float queuePriority = 1.0f;
-    vk::DeviceQueueCreateInfo queueCreateInfo{
-        .queueFamilyIndex = deviceQueue.queueFamilyIndex, .queueCount = 1, .pQueuePriorities = &queuePriority};
-    vk::PhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{.dynamicRendering = true};
+    std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos{vk::DeviceQueueCreateInfo{
+        .queueFamilyIndex = deviceQueue.queueFamilyIndex, .queueCount = 1, .pQueuePriorities = &queuePriority}};
+    for (uint32_t familyIndex : extraQueueFamilyIndices)
+    {
+        if (familyIndex != deviceQueue.queueFamilyIndex)
+            queueCreateInfos.push_back(vk::DeviceQueueCreateInfo{
+                .queueFamilyIndex = familyIndex, .queueCount = 1, .pQueuePriorities = &queuePriority});
+    }
+    // core since 1.3, vertex pulling reads buffers through their address
+    vk::PhysicalDeviceBufferDeviceAddressFeatures bufferDeviceAddressFeatures{.pNext = optionalFeatures,
+                                                                              .bufferDeviceAddress = true};
+    vk::PhysicalDeviceSynchronization2Features synchronization2Features{.pNext = &bufferDeviceAddressFeatures,
+                                                                        .synchronization2 = true};
+    vk::PhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures{.pNext = &synchronization2Features,
+                                                                          .timelineSemaphore = true};
+    vk::PhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{.pNext = &timelineSemaphoreFeatures,
+                                                                           .dynamicRendering = true};
     vk::PhysicalDeviceShaderObjectFeaturesEXT shaderObjFeatures{.pNext = &dynamicRenderingFeatures,
                                                                 .shaderObject = true};
     vk::DeviceCreateInfo deviceCreateInfo{.pNext = &shaderObjFeatures,
-                                          .queueCreateInfoCount = 1,
-                                          .pQueueCreateInfos = &queueCreateInfo,
+                                          .queueCreateInfoCount = (uint32_t)queueCreateInfos.size(),
+                                          .pQueueCreateInfos = queueCreateInfos.data(),
                                           .enabledLayerCount = (uint32_t)requiredDeviceLayers.size(),
                                           .ppEnabledLayerNames = requiredDeviceLayers.data(),
                                           .enabledExtensionCount = (uint32_t)requiredDeviceExtensions.size(),
@@ -139,6 +173,18 @@ vk::Device helpers::vulkan::create_device(DeviceQueueSelection deviceQueue,
     vk::Device device = deviceQueue.physicalDevice.createDevice(deviceCreateInfo);
     return device;
 }
+std::optional<uint32_t> helpers::vulkan::findDedicatedTransferQueueFamily(vk::PhysicalDevice physicalDevice)
+{
+    auto families = physicalDevice.getQueueFamilyProperties();
+    for (uint32_t i = 0; i < families.size(); ++i)
+    {
+        auto flags = families[i].queueFlags;
+        bool generalPurpose = static_cast<bool>(flags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute));
+        if ((flags & vk::QueueFlagBits::eTransfer) and !generalPurpose)
+            return i;
+    }
+    return std::nullopt;
+}
 std::optional<vk::SurfaceFormatKHR> helpers::vulkan::getSurfaceFormat(vk::PhysicalDevice physicalDevice,
                                                                       vk::SurfaceKHR surface, vk::Format format)
 {
@@ -152,6 +198,31 @@ std::optional<vk::SurfaceFormatKHR> helpers::vulkan::getSurfaceFormat(vk::Physic
     return *it;
 }
 
+vk::PresentModeKHR helpers::vulkan::choosePresentMode(vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface,
+                                                      vk::PresentModeKHR preferred)
+{
+    auto supportedPresentModes = physicalDevice.getSurfacePresentModesKHR(surface);
+    std::vector<vk::PresentModeKHR> candidates{preferred};
+    if (preferred == vk::PresentModeKHR::eMailbox)
+        candidates.push_back(vk::PresentModeKHR::eImmediate);
+    else if (preferred == vk::PresentModeKHR::eImmediate)
+        candidates.push_back(vk::PresentModeKHR::eMailbox);
+    for (auto candidate : candidates)
+    {
+        if (std::ranges::contains(supportedPresentModes, candidate))
+            return candidate;
+    }
+    return vk::PresentModeKHR::eFifo;
+}
+
+bool helpers::vulkan::isDeviceExtensionSupported(vk::PhysicalDevice physicalDevice, std::string_view extensionName)
+{
+    return std::ranges::contains(physicalDevice.enumerateDeviceExtensionProperties(), extensionName,
+                                 [](vk::ExtensionProperties const &extensionProp) {
+                                     return std::string_view(extensionProp.extensionName);
+                                 });
+}
+
 std::vector<uint32_t> getSpirvShaderCode(std::filesystem::path path)
 {
     std::ifstream file{path, std::ios::binary};
@@ -199,7 +270,8 @@ vk::ShaderEXT helpers::vulkan::createShaderExt(vk::Device device, std::filesyste
 };
 
 std::vector<vk::ShaderEXT> helpers::vulkan::createShadersExt(vk::Device device, std::filesystem::path vertexShaderPath,
-                                                             std::filesystem::path fragShaderPath)
+                                                             std::filesystem::path fragShaderPath,
+                                                             std::span<vk::PushConstantRange const> pushConstantRanges)
 {
     auto vertexCode = getSpirvShaderCode(vertexShaderPath);
     auto vertexPathStr = vertexShaderPath.string();
@@ -211,13 +283,17 @@ std::vector<vk::ShaderEXT> helpers::vulkan::createShadersExt(vk::Device device,
                                                       .codeType = vk::ShaderCodeTypeEXT::eSpirv,
                                                       .codeSize = vertexCode.size() * sizeof(uint32_t),
                                                       .pCode = vertexCode.data(),
-                                                      .pName = "main"};
+                                                      .pName = "main",
+                                                      .pushConstantRangeCount = (uint32_t)pushConstantRanges.size(),
+                                                      .pPushConstantRanges = pushConstantRanges.data()};
     vk::ShaderCreateInfoEXT fragShaderCreateInfoExt{.stage = vk::ShaderStageFlagBits::eFragment,
                                                     .nextStage = {},
                                                     .codeType = vk::ShaderCodeTypeEXT::eSpirv,
                                                     .codeSize = fragCode.size() * sizeof(uint32_t),
                                                     .pCode = fragCode.data(),
-                                                    .pName = "main"};
+                                                    .pName = "main",
+                                                    .pushConstantRangeCount = (uint32_t)pushConstantRanges.size(),
+                                                    .pPushConstantRanges = pushConstantRanges.data()};
 
     auto res = device.createShadersEXT({vertexShaderCreateInfoExt, fragShaderCreateInfoExt});
     if (res.result != vk::Result::eSuccess)
@@ -228,9 +304,9 @@ std::vector<vk::ShaderEXT> helpers::vulkan::createShadersExt(vk::Device device,
     return res.value;
 };
 
-std::vector<vk::UniqueShaderEXT> helpers::vulkan::createShadersExtUnique(vk::Device device,
-                                                                         std::filesystem::path vertexShaderPath,
-                                                                         std::filesystem::path fragShaderPath)
+std::vector<vk::UniqueShaderEXT> helpers::vulkan::createShadersExtUnique(
+    vk::Device device, std::filesystem::path vertexShaderPath, std::filesystem::path fragShaderPath,
+    std::span<vk::PushConstantRange const> pushConstantRanges)
 {
     auto vertexCode = getSpirvShaderCode(vertexShaderPath);
     auto vertexPathStr = vertexShaderPath.string();
@@ -242,13 +318,17 @@ std::vector<vk::UniqueShaderEXT> helpers::vulkan::createShadersExtUnique(vk::Dev
                                                       .codeType = vk::ShaderCodeTypeEXT::eSpirv,
                                                       .codeSize = vertexCode.size() * sizeof(uint32_t),
                                                       .pCode = vertexCode.data(),
-                                                      .pName = "main"};
+                                                      .pName = "main",
+                                                      .pushConstantRangeCount = (uint32_t)pushConstantRanges.size(),
+                                                      .pPushConstantRanges = pushConstantRanges.data()};
     vk::ShaderCreateInfoEXT fragShaderCreateInfoExt{.stage = vk::ShaderStageFlagBits::eFragment,
                                                     .nextStage = {},
                                                     .codeType = vk::ShaderCodeTypeEXT::eSpirv,
                                                     .codeSize = fragCode.size() * sizeof(uint32_t),
                                                     .pCode = fragCode.data(),
-                                                    .pName = "main"};
+                                                    .pName = "main",
+                                                    .pushConstantRangeCount = (uint32_t)pushConstantRanges.size(),
+                                                    .pPushConstantRanges = pushConstantRanges.data()};
 
     auto res = device.createShadersEXTUnique({vertexShaderCreateInfoExt, fragShaderCreateInfoExt});
     if (res.result != vk::Result::eSuccess)
@@ -2,6 +2,7 @@
 #pragma once
 #include "Exception.hpp"
 #include <filesystem>
+#include <span>
 #include <vector>
 
 #include "Vulkan.hpp"
@@ -72,21 +73,41 @@ DeviceQueueSelection getFirstSupportedDeviceQueueSelection(vk::Instance instance
                                                            vk::QueueFlags requiredFlags,
                                                            std::optional<vk::SurfaceKHR> surface = std::nullopt);
 
+// tries the device types in order of preference, e.g. discrete first and lavapipe (eCpu) as last resort
+DeviceQueueSelection getFirstSupportedDeviceQueueSelection(vk::Instance instance,
+                                                           std::span<vk::PhysicalDeviceType const> physicalDeviceTypes,
+                                                           vk::QueueFlags requiredFlags,
+                                                           std::optional<vk::SurfaceKHR> surface = std::nullopt);
+
+// optionalFeatures is chained after the features the engine requires, one queue of every extra family is created too
 vk::Device create_device(DeviceQueueSelection deviceQueue, std::vector<const char *> requiredDeviceExtensions,
-                         std::vector<const char *> requiredDeviceLayers);
+                         std::vector<const char *> requiredDeviceLayers, void *optionalFeatures = nullptr,
+                         std::span<uint32_t const> extraQueueFamilyIndices = {});
+
+// a family with transfer but neither graphics nor compute, usually the copy engine that runs next to rendering
+std::optional<uint32_t> findDedicatedTransferQueueFamily(vk::PhysicalDevice physicalDevice);
+
+bool isDeviceExtensionSupported(vk::PhysicalDevice physicalDevice, std::string_view extensionName);
 
 std::optional<vk::SurfaceFormatKHR> getSurfaceFormat(vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface,
                                                      vk::Format format);
 
+// preferred if the surface supports it, else the other low latency mode for mailbox/immediate, else fifo which is
+// always supported
+vk::PresentModeKHR choosePresentMode(vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface,
+                                     vk::PresentModeKHR preferred);
+
 vk::ShaderModule createShaderModule(vk::Device device, std::filesystem::path path);
 
 vk::ShaderEXT createShaderExt(vk::Device device, std::filesystem::path path);
 
+// push constant ranges have to match the pipeline layout the constants are pushed with
 std::vector<vk::ShaderEXT> createShadersExt(vk::Device device, std::filesystem::path vertexShaderPath,
-                                            std::filesystem::path fragShaderPath);
-
+                                            std::filesystem::path fragShaderPath,
+                                            std::span<vk::PushConstantRange const> pushConstantRanges = {});
 std::vector<vk::UniqueShaderEXT> createShadersExtUnique(vk::Device device, std::filesystem::path vertexShaderPath,
-                                                        std::filesystem::path fragShaderPath);
+                                                        std::filesystem::path fragShaderPath,
+                                                        std::span<vk::PushConstantRange const> pushConstantRanges = {});
 std::pair<uint32_t, vk::DeviceSize> getMemoryIndexAndSizeForBuffer(vk::PhysicalDevice physicalDevice, vk::Device device,
                                                                    vk::Buffer buffer,
                                                                    vk::MemoryPropertyFlags requiredMemFlags);
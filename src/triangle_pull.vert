@@ -0,0 +1,19 @@
+#version 450
+#extension GL_EXT_buffer_reference : require
+
+// Engine::Vertex read through its address instead of vertex input, 5 tightly packed floats
+layout(buffer_reference, std430, buffer_reference_align = 4) readonly buffer Floats {
+    float values[];
+};
+
+layout(push_constant) uniform PushConstants {
+    Floats vertices;
+} pc;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    uint base = uint(gl_VertexIndex) * 5u;
+    gl_Position = vec4(pc.vertices.values[base], pc.vertices.values[base + 1], 0.0, 1.0);
+    fragColor = vec3(pc.vertices.values[base + 2], pc.vertices.values[base + 3], pc.vertices.values[base + 4]);
+}
\ No newline at end of file
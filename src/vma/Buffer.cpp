@@ -4,34 +4,94 @@
 
 namespace vma
 {
+char const *to_string(MemoryTag tag)
+{
+    switch (tag)
+    {
+    case MemoryTag::eVertices:
+        return "vertices";
+    case MemoryTag::eIndices:
+        return "indices";
+    case MemoryTag::eStaging:
+        return "staging";
+    case MemoryTag::eGeometry:
+        return "geometry";
+    default:
+        return "other";
+    }
+}
 
-Buffer::Buffer(VmaAllocator allocator_, VkBufferCreateInfo const &bufferInfo, VmaAllocationCreateInfo const &allocInfo)
-    : allocator(allocator_)
+Buffer::Buffer(VmaAllocator allocator_, VkBufferCreateInfo const &bufferInfo, VmaAllocationCreateInfo const &allocInfo,
+               MemoryTag tag_)
+    : allocator(allocator_), tag(tag_)
 {
     if (bufferInfo.size != 0)
+    {
         VULKAN_CHECKTHROW(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &buffer, &allocation, nullptr));
+        vmaSetAllocationUserData(allocator, allocation, this);
+        vmaSetAllocationName(allocator, allocation, to_string(tag)); // shows up in vma's json dumps
+        taggedBytes[static_cast<size_t>(tag)] += bufferInfo.size;
+    }
     size_ = bufferInfo.size;
+    usage = bufferInfo.usage;
 }
 Buffer::~Buffer()
 {
-    if (allocator)
+    destroy();
+}
+void Buffer::destroy()
+{
+    if (allocation)
+        taggedBytes[static_cast<size_t>(tag)] -= size_;
+    // mid move the copy may still be in flight, the defragmenter frees both handles and the allocation after it
+    if (move)
+        move->owner = nullptr;
+    else if (allocator)
         vmaDestroyBuffer(allocator, buffer, allocation);
+    move = nullptr;
+}
+vk::DeviceAddress Buffer::getDeviceAddress()
+{
+    if (!buffer)
+        return 0;
+    VmaAllocatorInfo allocatorInfo;
+    vmaGetAllocatorInfo(allocator, &allocatorInfo);
+    return vk::Device(allocatorInfo.device).getBufferAddress(vk::BufferDeviceAddressInfo{.buffer = buffer});
+}
+void *Buffer::getMappedData()
+{
+    if (!allocation)
+        return nullptr;
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(allocator, allocation, &info);
+    return info.pMappedData;
 }
 Buffer::Buffer(Buffer &&other) noexcept
     : buffer(std::exchange(other.buffer, VK_NULL_HANDLE)), allocation(std::exchange(other.allocation, VK_NULL_HANDLE)),
-      allocator(std::exchange(other.allocator, VK_NULL_HANDLE))
+      allocator(std::exchange(other.allocator, VK_NULL_HANDLE)), size_(std::exchange(other.size_, 0)),
+      usage(std::exchange(other.usage, 0)), tag(other.tag), move(std::exchange(other.move, nullptr))
 {
+    if (allocation)
+        vmaSetAllocationUserData(allocator, allocation, this);
+    if (move)
+        move->owner = this;
 }
 Buffer &Buffer::operator=(Buffer &&other) noexcept
 {
     if (this != &other)
     {
-        if (allocator)
-            vmaDestroyBuffer(allocator, buffer, allocation);
+        destroy();
         buffer = std::exchange(other.buffer, VK_NULL_HANDLE);
         allocation = std::exchange(other.allocation, VK_NULL_HANDLE);
         allocator = std::exchange(other.allocator, VK_NULL_HANDLE);
         size_ = std::exchange(other.size_, 0);
+        usage = std::exchange(other.usage, 0);
+        tag = other.tag;
+        move = std::exchange(other.move, nullptr);
+        if (allocation)
+            vmaSetAllocationUserData(allocator, allocation, this);
+        if (move)
+            move->owner = this;
     }
     return *this;
 }
@@ -1,14 +1,42 @@
 #pragma once
 #include "Vma.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
 
 namespace vma
 {
-// RAII buffer with allocation
+class Buffer;
+
+// subsystem a buffer's memory is accounted to
+enum class MemoryTag : uint8_t
+{
+    eOther,
+    eVertices,
+    eIndices,
+    eStaging,
+    eGeometry,
+};
+inline constexpr size_t memoryTagCount = 5;
+char const *to_string(MemoryTag tag);
+
+// a move of a buffer's allocation by the Defragmenter, the old handle lives until the gpu finished the copy
+struct BufferMove
+{
+    Buffer *owner; // nullptr once the buffer was destroyed during the move, the defragmenter frees it then
+    VkBuffer oldBuffer;
+    VkBuffer newBuffer;
+};
+
+// RAII buffer with allocation.
+// the allocation's user data points back to the buffer, so the Defragmenter can swap in the handle of the new place
+// and the tag of any allocation can be looked up. live bytes are counted per tag
 class Buffer
 {
   public:
     Buffer() = default;
-    Buffer(VmaAllocator allocator, VkBufferCreateInfo const &buffer, VmaAllocationCreateInfo const &allocInfo);
+    Buffer(VmaAllocator allocator, VkBufferCreateInfo const &buffer, VmaAllocationCreateInfo const &allocInfo,
+           MemoryTag tag = MemoryTag::eOther);
     Buffer(Buffer const &) = delete;
     Buffer(Buffer &&) noexcept;
     Buffer &operator=(Buffer const &) = delete;
@@ -31,11 +59,36 @@ class Buffer
     {
         return size_;
     }
+    VkBufferUsageFlags getUsage()
+    {
+        return usage;
+    }
+    MemoryTag getTag()
+    {
+        return tag;
+    }
+    // bytes of all live buffers with the tag, thread safe
+    static vk::DeviceSize getTaggedBytes(MemoryTag tag)
+    {
+        return taggedBytes[static_cast<size_t>(tag)].load(std::memory_order_relaxed);
+    }
+    // needs VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 0 for an empty buffer
+    vk::DeviceAddress getDeviceAddress();
+    // persistent mapping of allocations created with VMA_ALLOCATION_CREATE_MAPPED_BIT, nullptr when not mappable
+    void *getMappedData();
 
   protected:
+    friend class Defragmenter;
+    static inline std::array<std::atomic<vk::DeviceSize>, memoryTagCount> taggedBytes{};
+
+    void destroy();
+
     VkBuffer buffer{};
     VmaAllocation allocation{};
     VmaAllocator allocator{};
     vk::DeviceSize size_{};
+    VkBufferUsageFlags usage{};
+    MemoryTag tag{};
+    BufferMove *move{}; // set while the defragmenter moves the allocation
 };
 } // namespace vma
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include "Defragmenter.hpp"
+#include "CpuTracer.hpp"
+#include "helpers_vulkan.hpp"
+#include <span>
+
+namespace vma
+{
+Defragmenter::Defragmenter(VmaAllocator allocator_, vk::Device device_, vk::DeviceSize maxBytesPerPass,
+                           uint32_t maxAllocationsPerPass)
+    : allocator(allocator_), device(device_),
+      info{.flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT,
+           .maxBytesPerPass = maxBytesPerPass,
+           .maxAllocationsPerPass = maxAllocationsPerPass}
+{
+}
+
+Defragmenter::~Defragmenter()
+{
+    if (passSubmitValue)
+        endPass();
+    if (context)
+        finish();
+}
+
+double Defragmenter::getUnusedRatio()
+{
+    VmaTotalStatistics total;
+    vmaCalculateStatistics(allocator, &total);
+    auto const &statistics = total.total.statistics;
+    if (statistics.blockBytes == 0)
+        return 0.0;
+    return static_cast<double>(statistics.blockBytes - statistics.allocationBytes) /
+           static_cast<double>(statistics.blockBytes);
+}
+
+void Defragmenter::start()
+{
+    if (context)
+        return;
+    VULKAN_CHECKTHROW(vmaBeginDefragmentation(allocator, &info, &context));
+    stats.runs++;
+}
+
+vk::DeviceSize Defragmenter::update(vk::CommandBuffer cmd, uint64_t completedValue, uint64_t submitValue)
+{
+    if (passSubmitValue and completedValue >= passSubmitValue.value())
+        endPass();
+    if (not context or passSubmitValue)
+        return 0;
+
+    NDEEX_TRACE_FUNCTION();
+    auto movedBefore = stats.movedBytes;
+    beginPass(cmd, submitValue);
+    return stats.movedBytes - movedBefore;
+}
+
+void Defragmenter::beginPass(vk::CommandBuffer cmd, uint64_t submitValue)
+{
+    auto result = vmaBeginDefragmentationPass(allocator, context, &pass);
+    if (result == VK_SUCCESS)
+    {
+        // nothing left to move
+        finish();
+        return;
+    }
+    if (result != VK_INCOMPLETE)
+        VULKAN_CHECKTHROW(result);
+
+    std::span passMoves(pass.pMoves, pass.moveCount);
+    moves.assign(passMoves.size(), BufferMove{});
+    bool recorded = false;
+    for (size_t i = 0; i < passMoves.size(); ++i)
+    {
+        auto &passMove = passMoves[i];
+        VmaAllocationInfo allocationInfo;
+        vmaGetAllocationInfo(allocator, passMove.srcAllocation, &allocationInfo);
+        VkMemoryPropertyFlags memoryProperties;
+        vmaGetAllocationMemoryProperties(allocator, passMove.srcAllocation, &memoryProperties);
+        auto *owner = static_cast<Buffer *>(allocationInfo.pUserData);
+        if (owner == nullptr or (memoryProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0)
+        {
+            passMove.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            continue;
+        }
+
+        if (not recorded)
+        {
+            // earlier submissions may still write the old places
+            vk::MemoryBarrier2 before{.srcStageMask = vk::PipelineStageFlagBits2::eAllCommands,
+                                      .srcAccessMask = vk::AccessFlagBits2::eMemoryWrite,
+                                      .dstStageMask = vk::PipelineStageFlagBits2::eCopy,
+                                      .dstAccessMask = vk::AccessFlagBits2::eTransferRead};
+            cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &before});
+            recorded = true;
+        }
+        auto newBuffer = device.createBuffer(
+            vk::BufferCreateInfo{.size = owner->size(), .usage = vk::BufferUsageFlags(owner->getUsage())});
+        VULKAN_CHECKTHROW(vmaBindBufferMemory(allocator, passMove.dstTmpAllocation, newBuffer));
+        cmd.copyBuffer(owner->buffer, newBuffer, vk::BufferCopy{.size = owner->size()});
+
+        moves[i] = BufferMove{.owner = owner, .oldBuffer = owner->buffer, .newBuffer = newBuffer};
+        owner->buffer = newBuffer;
+        owner->move = &moves[i];
+        stats.movedAllocations++;
+        stats.movedBytes += owner->size();
+    }
+    if (recorded)
+    {
+        // every later command of the queue, this frame's and the next frames', uses the new places
+        vk::MemoryBarrier2 after{.srcStageMask = vk::PipelineStageFlagBits2::eCopy,
+                                 .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+                                 .dstStageMask = vk::PipelineStageFlagBits2::eAllCommands,
+                                 .dstAccessMask = vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite};
+        cmd.pipelineBarrier2(vk::DependencyInfo{.memoryBarrierCount = 1, .pMemoryBarriers = &after});
+    }
+    passSubmitValue = submitValue;
+    stats.passes++;
+}
+
+void Defragmenter::endPass()
+{
+    std::span passMoves(pass.pMoves, pass.moveCount);
+    for (size_t i = 0; i < passMoves.size(); ++i)
+    {
+        auto &move = moves[i];
+        if (passMoves[i].operation != VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY)
+            continue;
+        device.destroyBuffer(move.oldBuffer);
+        if (move.owner)
+        {
+            move.owner->move = nullptr;
+            continue;
+        }
+        // destroyed during the move, vma frees both places
+        device.destroyBuffer(move.newBuffer);
+        passMoves[i].operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY;
+    }
+    moves.clear();
+    passSubmitValue.reset();
+    if (vmaEndDefragmentationPass(allocator, context, &pass) == VK_SUCCESS)
+        finish();
+}
+
+void Defragmenter::finish()
+{
+    VmaDefragmentationStats runStats{};
+    vmaEndDefragmentation(allocator, context, &runStats);
+    context = nullptr;
+    stats.freedBytes += runStats.bytesFreed;
+}
+} // namespace vma
\ No newline at end of file
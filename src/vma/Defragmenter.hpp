@@ -0,0 +1,65 @@
+#pragma once
+#include "Buffer.hpp"
+#include "Vma.hpp"
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace vma
+{
+// incremental compaction of the allocator's device local buffers, a bounded pass per frame.
+// update records the copies of a pass into the frame's command buffer and points the moved Buffers at their new
+// handles right away, later commands of the queue read the new place. the pass ends and the old places are freed
+// once the timeline passed the frame that copied, so neither the cpu nor the device waits.
+// host visible allocations stay where they are, their mappings are held onto, and so do images
+class Defragmenter
+{
+  public:
+    struct Stats
+    {
+        uint64_t runs = 0;
+        uint64_t passes = 0;
+        uint64_t movedAllocations = 0;
+        vk::DeviceSize movedBytes = 0;
+        vk::DeviceSize freedBytes = 0;
+    };
+
+    Defragmenter(VmaAllocator allocator, vk::Device device, vk::DeviceSize maxBytesPerPass,
+                 uint32_t maxAllocationsPerPass);
+    Defragmenter(Defragmenter const &) = delete;
+    Defragmenter &operator=(Defragmenter const &) = delete;
+    // the device has to be idle
+    ~Defragmenter();
+
+    // share of the allocated blocks not used by any allocation, walks all allocations so not every frame
+    double getUnusedRatio();
+    // starts a run unless one is going on
+    void start();
+    bool isRunning() const
+    {
+        return context != nullptr;
+    }
+    // once per frame before anything records the buffers. completedValue is what the timeline passed, submitValue what
+    // the submission of cmd signals. returns the bytes copied by cmd
+    vk::DeviceSize update(vk::CommandBuffer cmd, uint64_t completedValue, uint64_t submitValue);
+
+    Stats const &getStats() const
+    {
+        return stats;
+    }
+
+  private:
+    void beginPass(vk::CommandBuffer cmd, uint64_t submitValue);
+    void endPass();
+    void finish();
+
+    VmaAllocator allocator;
+    vk::Device device;
+    VmaDefragmentationInfo info;
+    VmaDefragmentationContext context{};
+    VmaDefragmentationPassMoveInfo pass{};
+    std::optional<uint64_t> passSubmitValue; // set while the copies of a pass are in flight
+    std::vector<BufferMove> moves; // parallel to pass.pMoves, sized once per pass so the Buffers can point into it
+    Stats stats;
+};
+} // namespace vma
\ No newline at end of file
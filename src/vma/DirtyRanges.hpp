@@ -0,0 +1,82 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <span>
+#include <vector>
+
+namespace vma
+{
+
+// sorted set of disjoint [begin, end) element ranges. ranges closer than mergeGap are coalesced, uploading a few
+// clean elements is cheaper than an extra copy region or flush
+class DirtyRanges
+{
+  public:
+    struct Range
+    {
+        size_t begin;
+        size_t end;
+    };
+
+    explicit DirtyRanges(size_t mergeGap = 0) : mergeGap(mergeGap)
+    {
+    }
+
+    void add(size_t begin, size_t end)
+    {
+        if (begin >= end)
+            return;
+        // first range that could touch the new one, then swallow every range it overlaps or nearly touches
+        auto first = std::ranges::lower_bound(ranges, begin, {}, [&](Range const &r) { return reach(r.end); });
+        auto last = first;
+        while (last != ranges.end() and last->begin <= reach(end))
+        {
+            begin = std::min(begin, last->begin);
+            end = std::max(end, last->end);
+            ++last;
+        }
+        first = ranges.erase(first, last);
+        ranges.insert(first, Range{begin, end});
+    }
+    // drops everything at or past size, for when the elements shrank
+    void clamp(size_t size)
+    {
+        std::erase_if(ranges, [&](Range const &r) { return r.begin >= size; });
+        if (!ranges.empty())
+            ranges.back().end = std::min(ranges.back().end, size);
+    }
+    void clear()
+    {
+        ranges.clear();
+    }
+
+    bool empty() const
+    {
+        return ranges.empty();
+    }
+    std::span<Range const> get() const
+    {
+        return ranges;
+    }
+    size_t elementCount() const
+    {
+        size_t count = 0;
+        for (auto const &r : ranges)
+            count += r.end - r.begin;
+        return count;
+    }
+
+  private:
+    // saturating, end may be max to mean up to the end
+    size_t reach(size_t end) const
+    {
+        constexpr auto max = std::numeric_limits<size_t>::max();
+        return end > max - mergeGap ? max : end + mergeGap;
+    }
+
+    std::vector<Range> ranges;
+    size_t mergeGap;
+};
+
+} // namespace vma
\ No newline at end of file
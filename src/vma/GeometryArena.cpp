@@ -0,0 +1,130 @@
+#include "GeometryArena.hpp"
+#include "CpuTracer.hpp"
+#include "helpers_vulkan.hpp"
+#include <bit>
+#include <cstring>
+#include <utility>
+
+namespace vma
+{
+GeometryArena::GeometryArena(VmaAllocator allocator, vk::DeviceSize capacity_, VkBufferUsageFlags extraUsage)
+    : capacity(capacity_)
+{
+    VkBufferCreateInfo bufferInfo{.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                                  .size = capacity,
+                                  .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                                           VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                           extraUsage};
+    buffer = Buffer(allocator, bufferInfo, VmaAllocationCreateInfo{.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE},
+                    MemoryTag::eGeometry);
+    VmaVirtualBlockCreateInfo blockInfo{.size = capacity};
+    VULKAN_CHECKTHROW(vmaCreateVirtualBlock(&blockInfo, &block));
+}
+
+GeometryArena::GeometryArena(GeometryArena &&other) noexcept
+    : buffer(std::move(other.buffer)), block(std::exchange(other.block, nullptr)),
+      capacity(std::exchange(other.capacity, 0)), uploadBytes(std::move(other.uploadBytes)),
+      uploadRegions(std::move(other.uploadRegions)), pendingSource(other.pendingSource),
+      pendingCopies(std::move(other.pendingCopies))
+{
+}
+
+GeometryArena &GeometryArena::operator=(GeometryArena &&other) noexcept
+{
+    if (this != &other)
+    {
+        if (block)
+        {
+            vmaClearVirtualBlock(block);
+            vmaDestroyVirtualBlock(block);
+        }
+        buffer = std::move(other.buffer);
+        block = std::exchange(other.block, nullptr);
+        capacity = std::exchange(other.capacity, 0);
+        uploadBytes = std::move(other.uploadBytes);
+        uploadRegions = std::move(other.uploadRegions);
+        pendingSource = other.pendingSource;
+        pendingCopies = std::move(other.pendingCopies);
+    }
+    return *this;
+}
+
+GeometryArena::~GeometryArena()
+{
+    if (block)
+    {
+        // ranges still handed out die with the buffer
+        vmaClearVirtualBlock(block);
+        vmaDestroyVirtualBlock(block);
+    }
+}
+
+GeometryArena::Range GeometryArena::allocate(vk::DeviceSize count, vk::DeviceSize stride)
+{
+    CHECKTHROW(block);
+    CHECKTHROW(count > 0);
+    // virtual alignments are powers of two, other strides get room to round the offset up to a multiple
+    bool powerOfTwo = std::has_single_bit(stride);
+    VmaVirtualAllocationCreateInfo allocInfo{.size = count * stride + (powerOfTwo ? 0 : stride - 1),
+                                             .alignment = powerOfTwo ? stride : 4};
+    Range range;
+    if (vmaVirtualAllocate(block, &allocInfo, &range.allocation, &range.offset) != VK_SUCCESS)
+        throw Core::runtime_error("geometry arena of {} bytes has no room for {} bytes, {} in use", capacity,
+                                  allocInfo.size, getUsedBytes());
+    range.offset = (range.offset + stride - 1) / stride * stride;
+    range.size = count * stride;
+    return range;
+}
+
+void GeometryArena::free(Range const &range)
+{
+    if (block and range.allocation)
+        vmaVirtualFree(block, range.allocation);
+}
+
+void GeometryArena::upload(Range const &range, std::span<std::byte const> data)
+{
+    CHECKTHROW(data.size() <= range.size);
+    if (data.empty())
+        return;
+    uploadRegions.push_back(
+        vk::BufferCopy{.srcOffset = uploadBytes.size(), .dstOffset = range.offset, .size = data.size()});
+    uploadBytes.insert(uploadBytes.end(), data.begin(), data.end());
+}
+
+size_t GeometryArena::commit(StagingRing &staging)
+{
+    pendingCopies.clear();
+    if (uploadRegions.empty())
+        return 0;
+    NDEEX_TRACE_SCOPE("geometry commit");
+    // packed like VertexBuffer's dirty ranges, one staging allocation, one flush and one copy command
+    auto bytes = uploadBytes.size();
+    auto allocation = staging.allocate(bytes);
+    std::memcpy(allocation.data.data(), uploadBytes.data(), bytes);
+    VULKAN_CHECKTHROW(vmaFlushAllocation(buffer.getAllocatorHandle(), allocation.allocation, allocation.offset, bytes));
+    for (auto &region : uploadRegions)
+        region.srcOffset += allocation.offset;
+    pendingSource = allocation.buffer;
+    std::swap(pendingCopies, uploadRegions);
+    uploadRegions.clear();
+    uploadBytes.clear();
+    return bytes;
+}
+
+void GeometryArena::recordUpload(vk::CommandBuffer cmd)
+{
+    if (!pendingCopies.empty())
+        cmd.copyBuffer(pendingSource, buffer.getBufferHandle(), pendingCopies);
+    pendingCopies.clear();
+}
+
+vk::DeviceSize GeometryArena::getUsedBytes() const
+{
+    if (!block)
+        return 0;
+    VmaStatistics statistics;
+    vmaGetVirtualBlockStatistics(block, &statistics);
+    return statistics.allocationBytes;
+}
+} // namespace vma
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+#include "Buffer.hpp"
+#include "StagingRing.hpp"
+#include "Vma.hpp"
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace vma
+{
+// one device local buffer holding the vertices and indices of many meshes, sub allocated with a vma virtual block.
+// meshes are ranges of it, so draws of different meshes share one vertex and index buffer bind and can be issued
+// as a single multi draw indirect. the capacity is fixed, it does not grow
+class GeometryArena
+{
+  public:
+    struct Range
+    {
+        VmaVirtualAllocation allocation{};
+        vk::DeviceSize offset = 0; // multiple of the stride, offset / stride is the first vertex or index
+        vk::DeviceSize size = 0;
+    };
+
+    GeometryArena() = default;
+    // extraUsage on top of vertex and index usage, e.g. for vertex pulling through the device address
+    GeometryArena(VmaAllocator allocator, vk::DeviceSize capacity, VkBufferUsageFlags extraUsage = 0);
+    GeometryArena(GeometryArena const &) = delete;
+    GeometryArena(GeometryArena &&) noexcept;
+    GeometryArena &operator=(GeometryArena const &) = delete;
+    GeometryArena &operator=(GeometryArena &&) noexcept;
+    ~GeometryArena();
+
+    // count elements of stride bytes, throws when the arena is full
+    Range allocate(vk::DeviceSize count, vk::DeviceSize stride);
+    // no frame may read the range anymore
+    void free(Range const &range);
+    // appended to the pending bytes, goes to the gpu with the next commit
+    void upload(Range const &range, std::span<std::byte const> data);
+    // moves the uploads into one staging allocation of the current frame with one flush, returns the bytes
+    size_t commit(StagingRing &staging);
+    bool isUploadPending() const
+    {
+        return !pendingCopies.empty();
+    }
+    // one copy command for all of them, the caller orders it against the vertex and index reads
+    void recordUpload(vk::CommandBuffer cmd);
+
+    vk::Buffer getBufferHandle()
+    {
+        return buffer.getBufferHandle();
+    }
+    vk::DeviceAddress getDeviceAddress()
+    {
+        return buffer.getDeviceAddress();
+    }
+    vk::DeviceSize getCapacity() const
+    {
+        return capacity;
+    }
+    vk::DeviceSize getUsedBytes() const;
+
+  private:
+    Buffer buffer;
+    VmaVirtualBlock block{};
+    vk::DeviceSize capacity = 0;
+    // the data of all uploads back to back, the regions' source offsets point into it until the commit
+    std::vector<std::byte> uploadBytes;
+    std::vector<vk::BufferCopy> uploadRegions;
+    vk::Buffer pendingSource;
+    std::vector<vk::BufferCopy> pendingCopies;
+};
+} // namespace vma
\ No newline at end of file
@@ -0,0 +1,35 @@
+#include "Image.hpp"
+#include "helpers_vulkan.hpp"
+#include <utility>
+
+namespace vma
+{
+
+Image::Image(VmaAllocator allocator_, VkImageCreateInfo const &imageInfo, VmaAllocationCreateInfo const &allocInfo)
+    : allocator(allocator_)
+{
+    VULKAN_CHECKTHROW(vmaCreateImage(allocator, &imageInfo, &allocInfo, &image, &allocation, nullptr));
+}
+Image::~Image()
+{
+    if (allocator)
+        vmaDestroyImage(allocator, image, allocation);
+}
+Image::Image(Image &&other) noexcept
+    : image(std::exchange(other.image, VK_NULL_HANDLE)), allocation(std::exchange(other.allocation, VK_NULL_HANDLE)),
+      allocator(std::exchange(other.allocator, VK_NULL_HANDLE))
+{
+}
+Image &Image::operator=(Image &&other) noexcept
+{
+    if (this != &other)
+    {
+        if (allocator)
+            vmaDestroyImage(allocator, image, allocation);
+        image = std::exchange(other.image, VK_NULL_HANDLE);
+        allocation = std::exchange(other.allocation, VK_NULL_HANDLE);
+        allocator = std::exchange(other.allocator, VK_NULL_HANDLE);
+    }
+    return *this;
+}
+} // namespace vma
\ No newline at end of file
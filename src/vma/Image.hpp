@@ -0,0 +1,36 @@
+#pragma once
+#include "Vma.hpp"
+
+namespace vma
+{
+// RAII image with allocation
+class Image
+{
+  public:
+    Image() = default;
+    Image(VmaAllocator allocator, VkImageCreateInfo const &imageInfo, VmaAllocationCreateInfo const &allocInfo);
+    Image(Image const &) = delete;
+    Image(Image &&) noexcept;
+    Image &operator=(Image const &) = delete;
+    Image &operator=(Image &&) noexcept;
+    ~Image();
+
+    VkImage getImageHandle()
+    {
+        return image;
+    }
+    VmaAllocation getAllocationHandle()
+    {
+        return allocation;
+    }
+    VmaAllocator getAllocatorHandle()
+    {
+        return allocator;
+    }
+
+  protected:
+    VkImage image{};
+    VmaAllocation allocation{};
+    VmaAllocator allocator{};
+};
+} // namespace vma
\ No newline at end of file
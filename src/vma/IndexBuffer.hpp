@@ -0,0 +1,25 @@
+#pragma once
+#include "VertexBuffer.hpp"
+#include <cstdint>
+#include <type_traits>
+
+namespace vma
+{
+
+// VertexBuffer with 16 or 32 bit indices bound as index buffer, modes, dirty ranges and growth work the same
+template <typename I> class IndexBuffer : public VertexBuffer<I, VK_BUFFER_USAGE_INDEX_BUFFER_BIT>
+{
+    static_assert(std::is_same_v<I, uint16_t> or std::is_same_v<I, uint32_t>, "indices are 16 or 32 bit");
+
+  public:
+    using VertexBuffer<I, VK_BUFFER_USAGE_INDEX_BUFFER_BIT>::VertexBuffer;
+
+    static constexpr vk::IndexType indexType = sizeof(I) == 2 ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+
+    std::vector<I> &indices()
+    {
+        return this->vertices();
+    }
+};
+
+} // namespace vma
\ No newline at end of file
@@ -0,0 +1,59 @@
+#include "StagingRing.hpp"
+#include "CpuTracer.hpp"
+#include "helpers.hpp"
+#include <algorithm>
+
+namespace vma
+{
+StagingRing::StagingRing(VmaAllocator allocator_, vk::DeviceSize bytesPerFrame, uint32_t framesInFlight)
+    : allocator(allocator_), bytesPerFrame(bytesPerFrame),
+      buffer(createBuffer(allocator, bytesPerFrame * std::max(framesInFlight, 1u))),
+      mapped(static_cast<std::byte *>(CHECKTHROW(buffer.getMappedData()))), overflow(std::max(framesInFlight, 1u))
+{
+}
+
+Buffer StagingRing::createBuffer(VmaAllocator allocator, vk::DeviceSize size)
+{
+    // transient vertex, index, indirect and constant data can be read in place besides being a copy source
+    VkBufferCreateInfo bufferInfo{.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                                  .size = size,
+                                  .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                                           VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT};
+    VmaAllocationCreateInfo allocInfo{
+        .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        .usage = VMA_MEMORY_USAGE_AUTO,
+    };
+    return Buffer(allocator, bufferInfo, allocInfo, MemoryTag::eStaging);
+}
+
+void StagingRing::beginFrame(uint32_t frameIndex)
+{
+    regionIndex = frameIndex % static_cast<uint32_t>(overflow.size());
+    cursor.store(0, std::memory_order_relaxed);
+    std::scoped_lock lock(overflowMutex);
+    overflow[regionIndex].clear();
+}
+
+StagingRing::Allocation StagingRing::allocate(vk::DeviceSize size, vk::DeviceSize alignment)
+{
+    auto offset = cursor.load(std::memory_order_relaxed);
+    vk::DeviceSize begin;
+    do
+    {
+        begin = (offset + alignment - 1) / alignment * alignment;
+        if (begin + size > bytesPerFrame)
+        {
+            NDEEX_TRACE_SCOPE("staging overflow");
+            std::scoped_lock lock(overflowMutex);
+            auto &dedicated = overflow[regionIndex].emplace_back(createBuffer(allocator, size));
+            auto *data = static_cast<std::byte *>(CHECKTHROW(dedicated.getMappedData()));
+            return Allocation{dedicated.getBufferHandle(), dedicated.getAllocationHandle(), 0, {data, size}};
+        }
+    } while (!cursor.compare_exchange_weak(offset, begin + size, std::memory_order_relaxed));
+
+    auto bufferOffset = regionIndex * bytesPerFrame + begin;
+    return Allocation{buffer.getBufferHandle(), buffer.getAllocationHandle(), bufferOffset,
+                      {mapped + bufferOffset, size}};
+}
+} // namespace vma
\ No newline at end of file
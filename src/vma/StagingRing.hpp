@@ -0,0 +1,58 @@
+#pragma once
+#include "Buffer.hpp"
+#include "Vma.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace vma
+{
+// engine wide persistently mapped upload memory, one linear region per frame in flight.
+// beginFrame resets the region once the gpu finished the frame that used it before, so allocating is a bump of an
+// offset and the memory is bounded no matter how many buffers upload through it
+class StagingRing
+{
+  public:
+    struct Allocation
+    {
+        vk::Buffer buffer;
+        VmaAllocation allocation; // for vmaFlushAllocation, offsets are the same as in the buffer
+        vk::DeviceSize offset;
+        std::span<std::byte> data; // mapped, write only
+    };
+
+    StagingRing(VmaAllocator allocator, vk::DeviceSize bytesPerFrame, uint32_t framesInFlight);
+    StagingRing(StagingRing const &) = delete;
+    StagingRing &operator=(StagingRing const &) = delete;
+
+    // the gpu is done with the previous frame of this frameIndex, its region and overflow buffers are reused
+    void beginFrame(uint32_t frameIndex);
+    // thread safe. what does not fit the rest of the region gets a dedicated buffer released with the region
+    Allocation allocate(vk::DeviceSize size, vk::DeviceSize alignment = 16);
+
+    vk::DeviceSize getBytesPerFrame() const
+    {
+        return bytesPerFrame;
+    }
+    // of the current frame, overflow buffers not included
+    vk::DeviceSize getUsedBytes() const
+    {
+        return std::min(cursor.load(std::memory_order_relaxed), bytesPerFrame);
+    }
+
+  private:
+    static Buffer createBuffer(VmaAllocator allocator, vk::DeviceSize size);
+
+    VmaAllocator allocator;
+    vk::DeviceSize bytesPerFrame;
+    Buffer buffer; // framesInFlight regions of bytesPerFrame
+    std::byte *mapped;
+    uint32_t regionIndex = 0;
+    std::atomic<vk::DeviceSize> cursor = 0; // into the current region
+    std::mutex overflowMutex;
+    std::vector<std::vector<Buffer>> overflow; // per region
+};
+} // namespace vma
\ No newline at end of file
@@ -1,31 +1,66 @@
 #pragma once
 #include "Allocator.hpp"
 #include "Buffer.hpp"
+#include "DirtyRanges.hpp"
+#include "StagingRing.hpp"
 #include "Vma.hpp"
+#include "helpers.hpp"
+#include <algorithm>
+#include <limits>
+#include <memory_resource>
+#include <span>
+#include <vector>
 
 namespace vma
 {
 
-// allows to maintain cpu buffer and gpu buffer in sync
-template <typename T> class VertexBuffer
+// allows to maintain cpu buffer and gpu buffer in sync.
+// keeps one gpu copy per frame in flight so updating never has to wait for the gpu to finish reading.
+// Usage is how the draws read it, IndexBuffer reuses everything with index usage
+template <typename T, VkBufferUsageFlags Usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT> class VertexBuffer
 {
   public:
+    enum class Mode
+    {
+        eDynamic, // cpu copy in vertices(), dirty ranges are committed to the gpu copy of each frame
+        eMapped,  // no cpu copy, map() writes straight into the persistently mapped gpu copy of the frame
+        eStatic,  // uploaded once into device local memory, the cpu copy is freed afterwards
+    };
+    // how the shaders get at the data, orthogonal to the upload mode
+    enum class Fetch
+    {
+        eBound,         // bound with Usage, e.g. vertex input
+        eDeviceAddress, // also pulled through getDeviceAddress() in the shader
+    };
+
     // main gpu buffer
     struct MBuffer : Buffer
     {
         MBuffer() = default;
-        MBuffer(VmaAllocator allocator, vk::DeviceSize size);
+        MBuffer(VmaAllocator allocator, vk::DeviceSize size, Mode mode, Fetch fetch);
         bool isStagingNeeded();
 
       private:
-        static VkBufferCreateInfo getBufferCreateInfo(vk::DeviceSize allocSize)
+        static VkBufferCreateInfo getBufferCreateInfo(vk::DeviceSize allocSize, Fetch fetch)
         {
+            VkBufferUsageFlags addressUsage = fetch == Fetch::eDeviceAddress
+                                                  ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+                                                  : 0;
             return {.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
                     .size = allocSize,
-                    .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT};
+                    .usage = Usage | addressUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                             VK_BUFFER_USAGE_TRANSFER_SRC_BIT}; // source when growing
         }
-        static VmaAllocationCreateInfo getAllocationCreateInfo()
+        static VmaAllocationCreateInfo getAllocationCreateInfo(Mode mode)
         {
+            if (mode == Mode::eMapped) // host visible guaranteed, preferably device local too
+                return {
+                    .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+                    .usage = VMA_MEMORY_USAGE_AUTO,
+                };
+            if (mode == Mode::eStatic) // never touched by the host, always filled through staging
+                return {.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE};
             return {
                 .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | // cpu must write it sequentially so
                                                                                   // memory chosen will be uncached and
@@ -39,55 +74,107 @@ template <typename T> class VertexBuffer
         }
     };
 
-    // staging gpu buffer
-    struct SBuffer : Buffer
-    {
-        SBuffer() = default;
-        SBuffer(VmaAllocator allocator, vk::DeviceSize size);
-
-      private:
-        static VkBufferCreateInfo getBufferCreateInfo(vk::DeviceSize allocSize)
-        {
-            return {.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-                    .size = allocSize,
-                    .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT};
-        }
-        static VmaAllocationCreateInfo getAllocationCreateInfo()
-        {
-            return {
-                .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | // cpu must write it sequentially so
-                                                                                  // memory chosen will be uncached and
-                                                                                  // write combined flushed
-                         VMA_ALLOCATION_CREATE_MAPPED_BIT,                        // allow mapping
-                .usage = VMA_MEMORY_USAGE_AUTO,
-            };
-        }
-    };
-
     VertexBuffer() = default;
+    // bufferCount should be the number of frames in flight, static buffers only need one copy.
+    // eDeviceAddress needs an allocator created with VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT
+    explicit VertexBuffer(uint32_t bufferCount, Mode mode = Mode::eDynamic, Fetch fetch = Fetch::eBound)
+        : copies(mode == Mode::eStatic ? 1u : std::max(bufferCount, 1u)), mode(mode), fetch(fetch),
+          framesInFlight(std::max(bufferCount, 1u))
+    {
+    }
 
-    void commit(size_t firstDirtyVertexIndex, Allocator &allocator, vk::CommandBuffer cmd);
+    static constexpr size_t toEnd = std::numeric_limits<size_t>::max();
+    // vertices [firstVertex, firstVertex + vertexCount) changed, for every gpu copy
+    void markDirty(size_t firstVertex, size_t vertexCount = toEnd)
+    {
+        auto end = vertexCount >= toEnd - firstVertex ? toEnd : firstVertex + vertexCount;
+        for (auto &copy : copies)
+            copy.dirty.add(firstVertex, end);
+    }
+    // writes the dirty ranges into the copy of frameIndex, or into staging memory of the frame when it is not host
+    // visible. the other copies catch up when their frame comes around. returns the bytes written.
+    // mapped buffers flush what map() handed out, static buffers upload once and drop vertices().
+    // vertices appended since the last commit are always uploaded. call it once per frame, replaced buffers are
+    // released frames in flight commits later. scratch of the commit comes from memory, e.g. the frame arena
+    size_t commit(Allocator &allocator, StagingRing &staging, uint32_t frameIndex = 0,
+                  std::pmr::memory_resource *memory = std::pmr::get_default_resource());
+    // mapped mode: the persistent mapping of the copy of frameIndex, grown to vertexCount. the copy was last written
+    // frames in flight ago, so write every vertex the frame draws. contents are lost when it grows
+    std::span<T> map(Allocator &allocator, size_t vertexCount, uint32_t frameIndex = 0);
+    // commit left staging or growth copies that have to be recorded before the frame reads the buffer
+    bool isUploadPending(uint32_t frameIndex = 0)
+    {
+        auto &copy = getCopy(frameIndex);
+        return !copy.pendingCopies.empty() or !copy.growthCopies.empty();
+    }
+    // records the pending copies, the caller orders them against the vertex reads
+    void recordUpload(vk::CommandBuffer cmd, uint32_t frameIndex = 0);
+    Mode getMode() const
+    {
+        return mode;
+    }
 
     std::vector<T> &vertices()
     {
         return cpuVertices;
     }
 
-    vk::Buffer getBufferHandle()
+    vk::Buffer getBufferHandle(uint32_t frameIndex = 0)
+    {
+        return getCopy(frameIndex).gpuBuffer.getBufferHandle();
+    }
+    // eDeviceAddress only. changes when the copy grows or gets defragmented, query it when recording
+    vk::DeviceAddress getDeviceAddress(uint32_t frameIndex = 0)
     {
-        return gpuBuffer.getBufferHandle();
+        CHECKTHROW(fetch == Fetch::eDeviceAddress);
+        return getCopy(frameIndex).gpuBuffer.getDeviceAddress();
+    }
+    Fetch getFetch() const
+    {
+        return fetch;
     }
 
   private:
-    void sendToGpu(size_t firstDirtyVertexIndex, Allocator &allocator, vk::CommandBuffer cmd);
+    // dirty ranges closer than this are uploaded as one, about the size of a non coherent flush atom
+    static constexpr size_t mergeGapBytes = 256;
+    // capacity multiplier when growing, keeps appending amortized O(1)
+    static constexpr vk::DeviceSize growthFactor = 2;
+
+    struct GpuCopy
+    {
+        MBuffer gpuBuffer;
+        DirtyRanges dirty{std::max<size_t>(mergeGapBytes / sizeof(T), 1)};
+        std::vector<vk::BufferCopy> pendingCopies;
+        vk::Buffer pendingSource; // staging ring buffer the pending copies read from
+        std::vector<vk::BufferCopy> growthCopies; // clean contents of the previous buffer, disjoint from the above
+        vk::Buffer growthSource;
+        size_t vertexCount = 0; // vertices the copy held after its last commit
+        size_t mappedCount = 0; // vertices handed out by map()
+    };
+    struct Retired
+    {
+        MBuffer buffer;
+        uint64_t releaseAt; // commit count after which no frame reads it anymore
+    };
+
+    GpuCopy &getCopy(uint32_t frameIndex)
+    {
+        return copies[frameIndex % copies.size()];
+    }
+    size_t sendToGpu(GpuCopy &copy, Allocator &allocator, StagingRing &staging, std::pmr::memory_resource *memory);
+    void grow(GpuCopy &copy, Allocator &allocator, vk::DeviceSize requiredSize);
     size_t getCpuBufferSize() const
     {
         return sizeof(T) * cpuVertices.size();
     }
 
     std::vector<T> cpuVertices;
-    MBuffer gpuBuffer;
-    std::optional<SBuffer> stagingBuffer;
+    std::vector<GpuCopy> copies = std::vector<GpuCopy>(1);
+    Mode mode = Mode::eDynamic;
+    Fetch fetch = Fetch::eBound;
+    uint32_t framesInFlight = 1;
+    uint64_t commitCount = 0;
+    std::vector<Retired> retired;
 };
 
 } // namespace vma
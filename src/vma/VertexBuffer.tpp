@@ -1,125 +1,165 @@
 #pragma once
+#include "CpuTracer.hpp"
 #include "VertexBuffer.hpp"
+#include "helpers.hpp"
+#include <cstring>
 #include <print>
 
 namespace vma
 {
 
-template <typename T>
-VertexBuffer<T>::MBuffer::MBuffer(VmaAllocator allocator, vk::DeviceSize size)
-    : Buffer(allocator, getBufferCreateInfo(size), getAllocationCreateInfo())
+template <typename T, VkBufferUsageFlags Usage>
+VertexBuffer<T, Usage>::MBuffer::MBuffer(VmaAllocator allocator, vk::DeviceSize size, Mode mode, Fetch fetch)
+    : Buffer(allocator, getBufferCreateInfo(size, fetch), getAllocationCreateInfo(mode),
+             (Usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT) != 0 ? MemoryTag::eIndices : MemoryTag::eVertices)
 {
 }
-template <typename T> bool VertexBuffer<T>::MBuffer::isStagingNeeded()
+template <typename T, VkBufferUsageFlags Usage>
+bool VertexBuffer<T, Usage>::MBuffer::isStagingNeeded()
 {
     VkMemoryPropertyFlags memPropFlags;
     vmaGetAllocationMemoryProperties(allocator, allocation, &memPropFlags);
     return !(memPropFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
 }
 
-template <typename T>
-VertexBuffer<T>::SBuffer::SBuffer(VmaAllocator allocator, vk::DeviceSize size)
-    : Buffer(allocator, getBufferCreateInfo(size), getAllocationCreateInfo())
+template <typename T, VkBufferUsageFlags Usage>
+size_t VertexBuffer<T, Usage>::commit(Allocator &allocator, StagingRing &staging, uint32_t frameIndex,
+                                      std::pmr::memory_resource *memory)
 {
-}
-
-template <typename T>
-void VertexBuffer<T>::commit(size_t firstDirtyVertexIndex, Allocator &allocator, vk::CommandBuffer cmd)
-{
-    if (firstDirtyVertexIndex >= cpuVertices.size())
-        return;
-
-    if (getCpuBufferSize() > gpuBuffer.size()) // cpu buffer bigger than gpu buffer -> needs reallocation
+    NDEEX_TRACE_SCOPE("vertex commit");
+    ++commitCount;
+    std::erase_if(retired, [&](Retired const &entry) { return entry.releaseAt <= commitCount; });
+
+    auto &copy = getCopy(frameIndex);
+    copy.pendingCopies.clear();
+    copy.growthCopies.clear();
+    if (mode == Mode::eMapped)
     {
-        std::println("reallocating gpu buffer from {} to {}", gpuBuffer.size(), getCpuBufferSize());
-        gpuBuffer = MBuffer(allocator.getHandle(), getCpuBufferSize()); // reallocate gpu buffer
-        sendToGpu(firstDirtyVertexIndex, allocator, cmd);
+        // the vertices are already in place, only non coherent memory needs the flush
+        auto bytes = copy.mappedCount * sizeof(T);
+        if (bytes > 0)
+            VULKAN_CHECKTHROW(
+                vmaFlushAllocation(allocator.getHandle(), copy.gpuBuffer.getAllocationHandle(), 0, bytes));
+        return bytes;
     }
-    else
+
+    copy.dirty.add(copy.vertexCount, cpuVertices.size()); // appended
+    copy.dirty.clamp(cpuVertices.size());
+    copy.vertexCount = cpuVertices.size();
+    if (copy.dirty.empty())
+        return 0;
+
+    if (getCpuBufferSize() > copy.gpuBuffer.size())
+        grow(copy, allocator, getCpuBufferSize());
+    auto bytesWritten = sendToGpu(copy, allocator, staging, memory);
+    copy.dirty.clear();
+    if (mode == Mode::eStatic)
+        std::vector<T>().swap(cpuVertices); // the gpu has the only copy from now on
+    return bytesWritten;
+}
+template <typename T, VkBufferUsageFlags Usage>
+std::span<T> VertexBuffer<T, Usage>::map(Allocator &allocator, size_t vertexCount, uint32_t frameIndex)
+{
+    CHECKTHROW(mode == Mode::eMapped);
+    auto &copy = getCopy(frameIndex);
+    copy.mappedCount = vertexCount;
+    if (vertexCount == 0)
+        return {};
+    if (vertexCount * sizeof(T) > copy.gpuBuffer.size())
+        grow(copy, allocator, vertexCount * sizeof(T)); // contents are rewritten anyway, nothing to preserve
+    return {static_cast<T *>(CHECKTHROW(copy.gpuBuffer.getMappedData())), vertexCount};
+}
+// geometric capacity, the old buffer is retired since frames in flight may still read it. what it holds and is not
+// dirty moves to the new buffer with a gpu copy instead of a re-upload, the regions never overlap the dirty ranges
+// so both copies need no ordering between them
+template <typename T, VkBufferUsageFlags Usage>
+void VertexBuffer<T, Usage>::grow(GpuCopy &copy, Allocator &allocator, vk::DeviceSize requiredSize)
+{
+    auto capacity = std::max(requiredSize, copy.gpuBuffer.size() * growthFactor);
+    std::println("growing gpu buffer from {} to {}", copy.gpuBuffer.size(), capacity);
+    auto old = std::exchange(copy.gpuBuffer, MBuffer(allocator.getHandle(), capacity, mode, fetch));
+
+    // static buffers may have given their old buffer to another queue family, they take the full upload
+    size_t keep = mode == Mode::eDynamic ? std::min(copy.vertexCount, cpuVertices.size()) : 0;
+    if (mode == Mode::eStatic)
+        copy.dirty.add(0, cpuVertices.size());
+    size_t clean = 0;
+    auto addClean = [&](size_t end) {
+        if (clean < end)
+            copy.growthCopies.push_back(vk::BufferCopy{
+                .srcOffset = clean * sizeof(T), .dstOffset = clean * sizeof(T), .size = (end - clean) * sizeof(T)});
+    };
+    for (auto const &range : copy.dirty.get())
     {
-        sendToGpu(firstDirtyVertexIndex, allocator, cmd);
+        addClean(std::min(range.begin, keep));
+        clean = std::max(clean, range.end);
     }
+    addClean(keep);
+
+    copy.growthSource = old.getBufferHandle();
+    if (old.size() > 0)
+        retired.push_back(Retired{std::move(old), commitCount + framesInFlight});
+}
+template <typename T, VkBufferUsageFlags Usage>
+void VertexBuffer<T, Usage>::recordUpload(vk::CommandBuffer cmd, uint32_t frameIndex)
+{
+    auto &copy = getCopy(frameIndex);
+    if (!copy.growthCopies.empty())
+        cmd.copyBuffer(copy.growthSource, copy.gpuBuffer.getBufferHandle(), copy.growthCopies);
+    if (!copy.pendingCopies.empty())
+        cmd.copyBuffer(copy.pendingSource, copy.gpuBuffer.getBufferHandle(), copy.pendingCopies);
+    copy.pendingCopies.clear();
+    copy.growthCopies.clear();
 }
-template <typename T>
-void VertexBuffer<T>::sendToGpu(size_t firstDirtyVertexIndex, Allocator &allocator, vk::CommandBuffer cmd)
+// host writes are visible to the gpu at submission, so only the staging copy needs ordering on the gpu
+template <typename T, VkBufferUsageFlags Usage>
+size_t VertexBuffer<T, Usage>::sendToGpu(GpuCopy &copy, Allocator &allocator, StagingRing &staging,
+                                         std::pmr::memory_resource *memory)
 {
+    auto &gpuBuffer = copy.gpuBuffer;
+    auto ranges = copy.dirty.get();
+    size_t bytesWritten = 0;
+
     // https://gpuopen-librariesandsdks.github.io/VulkanMemoryAllocator/html/usage_patterns.html
-    if (gpuBuffer.isStagingNeeded())
+    // static buffers are not created mapped, they take the staging path even in host visible memory
+    if (gpuBuffer.isStagingNeeded() or !gpuBuffer.getMappedData())
     {
-        std::println("using staging buffer");
-        if (!stagingBuffer or getCpuBufferSize() > stagingBuffer.value().size()) // reallocate staging buffer if needed
+        // ranges packed back to back into the frame's staging memory, one flush and one copy command
+        auto totalBytes = copy.dirty.elementCount() * sizeof(T);
+        auto upload = staging.allocate(totalBytes);
+        for (auto const &range : ranges)
         {
-            stagingBuffer = SBuffer(allocator.getHandle(), gpuBuffer.size());
+            VkDeviceSize sizeBytes = (range.end - range.begin) * sizeof(T);
+            std::memcpy(upload.data.data() + bytesWritten, &cpuVertices[range.begin], sizeBytes);
+            copy.pendingCopies.push_back(vk::BufferCopy{
+                .srcOffset = upload.offset + bytesWritten, .dstOffset = range.begin * sizeof(T), .size = sizeBytes});
+            bytesWritten += sizeBytes;
         }
-
-        void *cpuDataPtr = &cpuVertices[firstDirtyVertexIndex];
-        VkDeviceSize gpuOffsetBytes = firstDirtyVertexIndex * sizeof(T);
-        VkDeviceSize copySizeBytes = getCpuBufferSize() - gpuOffsetBytes;
-
-        VULKAN_CHECKTHROW(vmaCopyMemoryToAllocation(allocator.getHandle(), cpuDataPtr,
-                                                    stagingBuffer.value().getAllocationHandle(), gpuOffsetBytes,
-                                                    copySizeBytes));
-
-        // Calling vmaCopyMemoryToAllocation() does vmaMapMemory(), memcpy(), vmaUnmapMemory(), and
-        // vmaFlushAllocation()
-        vk::BufferMemoryBarrier cpuWToStageBufRBarrier{
-            .srcAccessMask = vk::AccessFlagBits::eHostWrite,
-            .dstAccessMask = vk::AccessFlagBits::eTransferRead,
-            .srcQueueFamilyIndex = vk::QueueFamilyIgnored,
-            .dstQueueFamilyIndex = vk::QueueFamilyIgnored,
-            .buffer = stagingBuffer.value().getBufferHandle(),
-            .offset = gpuOffsetBytes,
-            .size = copySizeBytes,
-        };
-        // Insert a buffer memory barrier to make sure cpu writing to the staging buffer has finished.
-        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eHost, vk::PipelineStageFlagBits::eTransfer, {}, {},
-                            cpuWToStageBufRBarrier, {});
-
-        cmd.copyBuffer(stagingBuffer.value().getBufferHandle(), gpuBuffer.getBufferHandle(),
-                       vk::BufferCopy{.srcOffset = gpuOffsetBytes, .dstOffset = gpuOffsetBytes, .size = copySizeBytes});
-
-        vk::BufferMemoryBarrier stageBufWToGpuBufRBarrier{
-            .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
-            .dstAccessMask = vk::AccessFlagBits::eVertexAttributeRead,
-            .srcQueueFamilyIndex = vk::QueueFamilyIgnored,
-            .dstQueueFamilyIndex = vk::QueueFamilyIgnored,
-            .buffer = gpuBuffer.getBufferHandle(),
-            .offset = gpuOffsetBytes,
-            .size = copySizeBytes,
-        };
-
-        // Make sure copying from staging buffer to the actual buffer has finished by inserting a buffer memory
-        // barrier.
-        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eVertexInput, {}, {},
-                            stageBufWToGpuBufRBarrier, {});
+        copy.pendingSource = upload.buffer;
+        // no-op on host coherent memory
+        VULKAN_CHECKTHROW(vmaFlushAllocation(allocator.getHandle(), upload.allocation, upload.offset, totalBytes));
+        return bytesWritten;
     }
-    else
-    {
-        // The Allocation ended up in a mappable memory.
-
-        // Calling vmaCopyMemoryToAllocation() does vmaMapMemory(), memcpy(), vmaUnmapMemory(), and
-        // vmaFlushAllocation()
-        void *cpuDataPtr = &cpuVertices[firstDirtyVertexIndex];
-        VkDeviceSize gpuOffsetBytes = firstDirtyVertexIndex * sizeof(T);
-        VkDeviceSize copySizeBytes = getCpuBufferSize() - gpuOffsetBytes;
 
-        VULKAN_CHECKTHROW(vmaCopyMemoryToAllocation(allocator.getHandle(), cpuDataPtr, gpuBuffer.getAllocationHandle(),
-                                                    gpuOffsetBytes, copySizeBytes));
-
-        vk::BufferMemoryBarrier cpuWToGpuBufRBarrier{
-            .srcAccessMask = vk::AccessFlagBits::eHostWrite,
-            .dstAccessMask = vk::AccessFlagBits::eVertexAttributeRead, // We created a uniform buffer
-            .srcQueueFamilyIndex = vk::QueueFamilyIgnored,
-            .dstQueueFamilyIndex = vk::QueueFamilyIgnored,
-            .buffer = gpuBuffer.getBufferHandle(),
-            .offset = gpuOffsetBytes,
-            .size = copySizeBytes,
-        };
-
-        // It's important to insert a buffer memory barrier here to ensure writing to the buffer has finished.
-        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eHost, vk::PipelineStageFlagBits::eVertexInput, {}, {},
-                            cpuWToGpuBufRBarrier, {});
+    // the allocation ended up in mappable memory, each range is written in place and flushed on its own
+    auto *mapped = static_cast<std::byte *>(gpuBuffer.getMappedData());
+    std::pmr::vector<VmaAllocation> allocations(ranges.size(), gpuBuffer.getAllocationHandle(), memory);
+    std::pmr::vector<VkDeviceSize> offsets(memory);
+    std::pmr::vector<VkDeviceSize> sizes(memory);
+    offsets.reserve(ranges.size());
+    sizes.reserve(ranges.size());
+    for (auto const &range : ranges)
+    {
+        VkDeviceSize offsetBytes = range.begin * sizeof(T);
+        VkDeviceSize sizeBytes = (range.end - range.begin) * sizeof(T);
+        std::memcpy(mapped + offsetBytes, &cpuVertices[range.begin], sizeBytes);
+        offsets.push_back(offsetBytes);
+        sizes.push_back(sizeBytes);
+        bytesWritten += sizeBytes;
     }
+    VULKAN_CHECKTHROW(vmaFlushAllocations(allocator.getHandle(), static_cast<uint32_t>(ranges.size()),
+                                          allocations.data(), offsets.data(), sizes.data()));
+    return bytesWritten;
 }
 
 } // namespace vma
\ No newline at end of file